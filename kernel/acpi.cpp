@@ -0,0 +1,96 @@
+#include <limine/limine.h>
+#include <kernel/acpi.hpp>
+#include <kernel/memory/paging.hpp>
+#include <kernel/log.hpp>
+
+static volatile limine_rsdp_request rsdp_request = {
+	.id = LIMINE_RSDP_REQUEST,
+	.revision = 0,
+	.response = nullptr,
+};
+
+struct [[gnu::packed]] RSDP {
+	char signature[8];
+	u8 checksum;
+	char oem_id[6];
+	u8 revision;
+	u32 rsdt_address;
+	// the fields below are only valid for revision >= 2
+	u32 length;
+	u64 xsdt_address;
+	u8 extended_checksum;
+	u8 reserved[3];
+};
+
+static_assert(sizeof(RSDP) == 36);
+
+using kernel::acpi::SDTHeader;
+
+// either the RSDT (32-bit entries) or the XSDT (64-bit entries)
+static const SDTHeader* root_table = nullptr;
+static bool use_xsdt = false;
+
+static bool is_checksum_valid(const void* data, usize size) {
+	u8 sum = 0;
+	for (usize i = 0; i < size; ++i) {
+		sum += reinterpret_cast<const u8*>(data)[i];
+	}
+	return sum == 0;
+}
+
+// tables are referenced by physical address, which limine covers with the HHDM
+static const SDTHeader* map_table(uptr phys) {
+	return reinterpret_cast<const SDTHeader*>(kernel::PhysicalAddress(phys).to_virtual().ptr());
+}
+
+void kernel::acpi::init() {
+	if (!rsdp_request.response || !rsdp_request.response->address)
+		panic("No response for RSDP request");
+
+	// normalize through the physical address, so this works whether limine
+	// gives us a HHDM pointer or the raw physical address
+	const auto rsdp_phys = VirtualAddress(rsdp_request.response->address).to_physical();
+	const auto* rsdp = reinterpret_cast<const RSDP*>(rsdp_phys.to_virtual().ptr());
+
+	if (!is_checksum_valid(rsdp, 20))
+		panic("Invalid RSDP checksum");
+
+	if (rsdp->revision >= 2 && rsdp->xsdt_address) {
+		use_xsdt = true;
+		root_table = map_table(rsdp->xsdt_address);
+	} else {
+		root_table = map_table(rsdp->rsdt_address);
+	}
+
+	if (!is_checksum_valid(root_table, root_table->length))
+		panic("Invalid {} checksum", use_xsdt ? "XSDT" : "RSDT");
+
+	kdbgln("ACPI initialized (revision {}, using {})", rsdp->revision, use_xsdt ? "XSDT" : "RSDT");
+}
+
+const SDTHeader* kernel::acpi::find_table(mat::StringView signature) {
+	if (!root_table) return nullptr;
+
+	const auto entry_size = use_xsdt ? sizeof(u64) : sizeof(u32);
+	const auto count = (root_table->length - sizeof(SDTHeader)) / entry_size;
+	const auto* entries = reinterpret_cast<const u8*>(root_table) + sizeof(SDTHeader);
+
+	for (usize i = 0; i < count; ++i) {
+		// entries are not necessarily aligned, so read them byte by byte
+		uptr phys = 0;
+		for (usize j = 0; j < entry_size; ++j) {
+			phys |= uptr(entries[i * entry_size + j]) << (j * 8);
+		}
+
+		const auto* table = map_table(phys);
+		if (mat::StringView(table->signature, table->signature + 4) != signature) continue;
+
+		if (!is_checksum_valid(table, table->length)) {
+			kdbgln("[ACPI] table {} has an invalid checksum, ignoring", signature);
+			continue;
+		}
+		return table;
+	}
+
+	return nullptr;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stl/types.hpp>
+#include <stl/string.hpp>
+
+namespace kernel::acpi {
+
+// Header shared by every ACPI System Description Table
+struct [[gnu::packed]] SDTHeader {
+	char signature[4];
+	u32 length;
+	u8 revision;
+	u8 checksum;
+	char oem_id[6];
+	char oem_table_id[8];
+	u32 oem_revision;
+	u32 creator_id;
+	u32 creator_revision;
+};
+
+static_assert(sizeof(SDTHeader) == 36);
+
+// Multiple APIC Description Table, signature "APIC"
+struct [[gnu::packed]] MADT {
+	SDTHeader header;
+	u32 lapic_address;
+	u32 flags;
+	// followed by a list of variable sized entries, each starting with MADTEntry
+};
+
+struct [[gnu::packed]] MADTEntry {
+	enum class Type : u8 {
+		LocalAPIC = 0,
+		IOAPIC = 1,
+		InterruptSourceOverride = 2,
+		NMISource = 3,
+		LocalAPICNMI = 4,
+		LocalAPICAddressOverride = 5,
+		LocalX2APIC = 9,
+	};
+
+	Type type;
+	u8 length;
+};
+
+void init();
+
+// Finds a table by its 4 character signature, such as "APIC".
+// Returns nullptr if the table is not present or its checksum is wrong.
+const SDTHeader* find_table(mat::StringView signature);
+
+// Calls func for every entry in the MADT, with a pointer to the entry header.
+template <class Func>
+void for_each_madt_entry(const MADT* madt, Func func) {
+	const auto* ptr = reinterpret_cast<const u8*>(madt) + sizeof(MADT);
+	const auto* end = reinterpret_cast<const u8*>(madt) + madt->header.length;
+	while (ptr + sizeof(MADTEntry) <= end) {
+		const auto* entry = reinterpret_cast<const MADTEntry*>(ptr);
+		// a zero length entry would loop forever
+		if (entry->length < sizeof(MADTEntry)) break;
+		func(entry);
+		ptr += entry->length;
+	}
+}
+
+}
@@ -0,0 +1,79 @@
+#include <kernel/alternatives.hpp>
+#include <kernel/log.hpp>
+#include <kernel/intrinsics.hpp>
+
+using namespace kernel;
+using alternatives::Entry;
+
+// from linker.ld. hidden so they're reached rip relative instead of through the GOT
+extern "C" [[gnu::visibility("hidden")]] const Entry __alternatives_start[];
+extern "C" [[gnu::visibility("hidden")]] const Entry __alternatives_end[];
+
+// supervisor writes to read only pages fault while this is set, which includes .text
+static constexpr u64 CR0_WP = 1 << 16;
+
+// the recommended multi byte nops, so padding decodes as few instructions as possible
+static constexpr usize MAX_NOP_LENGTH = 8;
+static constexpr u8 NOPS[MAX_NOP_LENGTH][MAX_NOP_LENGTH] = {
+	{ 0x90 },
+	{ 0x66, 0x90 },
+	{ 0x0f, 0x1f, 0x00 },
+	{ 0x0f, 0x1f, 0x40, 0x00 },
+	{ 0x0f, 0x1f, 0x44, 0x00, 0x00 },
+	{ 0x66, 0x0f, 0x1f, 0x44, 0x00, 0x00 },
+	{ 0x0f, 0x1f, 0x80, 0x00, 0x00, 0x00, 0x00 },
+	{ 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 },
+};
+
+// plain loops, memcpy goes through the dispatch table and this is rewriting code
+static void write_bytes(u8* dest, const u8* src, usize count) {
+	for (usize i = 0; i < count; ++i) {
+		dest[i] = src[i];
+	}
+}
+
+static void write_nops(u8* dest, usize count) {
+	while (count) {
+		const auto length = count < MAX_NOP_LENGTH ? count : MAX_NOP_LENGTH;
+		write_bytes(dest, NOPS[length - 1], length);
+		dest += length;
+		count -= length;
+	}
+}
+
+static void patch(const Entry& entry) {
+	auto* site = reinterpret_cast<u8*>(uptr(&entry.site_offset) + entry.site_offset);
+	const auto* replacement = reinterpret_cast<const u8*>(uptr(&entry.replacement_offset) + entry.replacement_offset);
+
+	// the macro pads the site, so the replacement always fits
+	if (entry.replacement_length > entry.site_length) {
+		panic("Alternative at {:#x} doesn't fit ({} > {} bytes)", uptr(site), entry.replacement_length, entry.site_length);
+	}
+
+	write_bytes(site, replacement, entry.replacement_length);
+	write_nops(site + entry.replacement_length, entry.site_length - entry.replacement_length);
+}
+
+void kernel::alternatives::init() {
+	usize total = 0;
+	usize patched = 0;
+
+	const auto flags = irq_save();
+	const auto cr0 = get_cr0();
+	set_cr0(cr0 & ~CR0_WP);
+
+	for (const auto* entry = __alternatives_start; entry < __alternatives_end; ++entry) {
+		total++;
+		if (!features::has(static_cast<features::Feature>(entry->feature))) continue;
+		patch(*entry);
+		patched++;
+	}
+
+	set_cr0(cr0);
+	// cross modifying code isn't a concern with only this CPU up, but a serializing
+	// instruction makes sure nothing stale from before the writes gets executed
+	cpuid(0);
+	irq_restore(flags);
+
+	kdbgln("Alternatives initialized, patched {} of {} sites", patched, total);
+}
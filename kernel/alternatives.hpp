@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stl/types.hpp>
+#include <kernel/features.hpp>
+
+// Boot time code patching. A site is assembled with a baseline sequence that works on any
+// x86-64 CPU, and `apply` overwrites it in place with the replacement if the CPU has the feature.
+// Unlike the dispatch table there's no indirect call left afterwards, so this is meant for
+// tiny sequences right in the middle of hot paths.
+//
+// Use it inside an extended asm statement, which also has to pass the feature as an operand:
+//
+//	asm volatile(ALTERNATIVE("lfence; rdtsc", "rdtscp") : ... : ALTERNATIVE_FEATURE(Feature::RDTSCP) : ...);
+//
+// The replacement is copied somewhere else before it runs, so it can't contain anything
+// rip relative (jumps, calls, or rip relative memory operands). The baseline stays where
+// it is, so it can. Whichever one is shorter gets padded with nops.
+
+#define ALTERNATIVE(baseline, replacement) \
+	"661:\n\t" baseline "\n662:\n\t" \
+	/* pad the baseline to the length of the replacement, gas comparisons are -1 for true */ \
+	".skip -(((665f - 664f) - (662b - 661b)) > 0) * ((665f - 664f) - (662b - 661b)), 0x90\n" \
+	"663:\n\t" \
+	".pushsection .alternatives, \"a\"\n\t" \
+	".long 661b - .\n\t" \
+	".long 664f - .\n\t" \
+	".word %c[alt_feature]\n\t" \
+	".byte 663b - 661b\n\t" \
+	".byte 665f - 664f\n\t" \
+	".popsection\n\t" \
+	".pushsection .altinstr_replacement, \"ax\"\n" \
+	"664:\n\t" replacement "\n665:\n\t" \
+	".popsection\n"
+
+#define ALTERNATIVE_FEATURE(feature) [alt_feature] "i"(static_cast<u16>(feature))
+
+namespace kernel::alternatives {
+
+// One patch site, as laid out by the ALTERNATIVE macro in the .alternatives section.
+// The offsets are relative to the field itself, so the table doesn't need any relocations.
+struct [[gnu::packed]] Entry {
+	i32 site_offset;
+	i32 replacement_offset;
+	u16 feature;
+	// including the nop padding
+	u8 site_length;
+	u8 replacement_length;
+};
+static_assert(sizeof(Entry) == 12);
+
+// Patches every site whose feature the CPU has. Must be called after `features::init`, and
+// before any other CPU is started, since it's rewriting code they could be running.
+void init();
+
+// Whether `feature` is supported, as a patched jump instead of a load and a test.
+// Before `init` this always says no, so the code behind it has to be optional.
+[[gnu::always_inline]] inline bool static_has(features::Feature feature) {
+	asm goto(ALTERNATIVE("jmp %l[no]", "") : : ALTERNATIVE_FEATURE(feature) : : no);
+	return true;
+no:
+	return false;
+}
+
+}
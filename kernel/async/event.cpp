@@ -0,0 +1,44 @@
+#include <kernel/async/event.hpp>
+#include <kernel/async/executor.hpp>
+#include <kernel/log.hpp>
+
+using namespace kernel;
+using namespace kernel::async;
+
+void kernel::async::IrqEvent::signal() {
+	const auto flags = m_lock.lock_irqsave();
+	// posted with the lock held, so that once the awaiter is gone it can't be posted anymore
+	if (m_waiter) {
+		post(m_waiter);
+		m_waiter = nullptr;
+	} else {
+		m_pending = true;
+	}
+	m_lock.unlock_irqrestore(flags);
+}
+
+kernel::async::IrqEvent::Awaiter::~Awaiter() {
+	const auto flags = event.m_lock.lock_irqsave();
+	if (event.m_waiter == &resumable) {
+		event.m_waiter = nullptr;
+	}
+	event.m_lock.unlock_irqrestore(flags);
+}
+
+bool kernel::async::IrqEvent::Awaiter::await_suspend(std::coroutine_handle<> handle) noexcept {
+	resumable.handle = handle;
+
+	const auto flags = event.m_lock.lock_irqsave();
+	if (event.m_pending) {
+		// already signalled, keep going without suspending
+		event.m_pending = false;
+		event.m_lock.unlock_irqrestore(flags);
+		return false;
+	}
+	if (event.m_waiter) {
+		panic("Two coroutines waiting on the same IRQ event");
+	}
+	event.m_waiter = &resumable;
+	event.m_lock.unlock_irqrestore(flags);
+	return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stl/types.hpp>
+#include <kernel/async/task.hpp>
+#include <kernel/sync/spinlock.hpp>
+
+namespace kernel::async {
+
+// Something a coroutine can wait on, that gets signalled from an interrupt handler.
+// Signals don't stack up: if it gets signalled a few times before anything waits,
+// the next wait finishes right away, and only once. So a driver should drain
+// everything the device has when woken, not assume one signal per byte.
+// Only one coroutine may wait on it at a time.
+class IrqEvent {
+	Resumable* m_waiter = nullptr;
+	bool m_pending = false;
+	sync::SpinLock m_lock;
+
+public:
+	// Resumes the waiting coroutine on the executor, or lets the next wait go through
+	// if nothing is waiting yet. Safe from interrupt handlers, and from any CPU.
+	void signal();
+
+	struct Awaiter {
+		IrqEvent& event;
+		Resumable resumable;
+
+		// the task may get destroyed while waiting, which must not leave the event pointing into its frame
+		~Awaiter();
+
+		bool await_ready() noexcept { return false; }
+		bool await_suspend(std::coroutine_handle<> handle) noexcept;
+		void await_resume() noexcept {}
+	};
+
+	// co_await this to wait for the next signal.
+	Awaiter wait() { return Awaiter { *this, {} }; }
+};
+
+}
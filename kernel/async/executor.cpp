@@ -0,0 +1,113 @@
+#include <kernel/async/executor.hpp>
+#include <kernel/sched/scheduler.hpp>
+#include <kernel/sync/spinlock.hpp>
+#include <kernel/sync/wait_queue.hpp>
+#include <kernel/log.hpp>
+
+using namespace kernel;
+using namespace kernel::async;
+
+// coroutines ready to be resumed, oldest first
+static Resumable* ready_head = nullptr;
+static Resumable* ready_tail = nullptr;
+// the ones taken off the ready list and being resumed right now, still
+// here so that resuming one can cancel the others. protected by ready_lock too
+static Resumable* batch_head = nullptr;
+static sync::SpinLock ready_lock;
+// the executor thread sleeps on this while nothing is ready
+static sync::WaitQueue ready_queue;
+
+static u64 resumed = 0;
+static u64 max_batch = 0;
+
+static void run(void*) {
+	while (true) {
+		ready_queue.wait_until([] {
+			return __atomic_load_n(&ready_head, __ATOMIC_ACQUIRE) != nullptr;
+		});
+
+		// take everything at once, anything posted while these run goes in the next batch
+		auto flags = ready_lock.lock_irqsave();
+		batch_head = ready_head;
+		ready_head = ready_tail = nullptr;
+		ready_lock.unlock_irqrestore(flags);
+
+		u64 batch = 0;
+		while (true) {
+			// taken off before resuming, as that may free the frame the item lives in, or queue it up again
+			flags = ready_lock.lock_irqsave();
+			auto* item = batch_head;
+			if (item) {
+				batch_head = item->next;
+				__atomic_store_n(&item->queued, false, __ATOMIC_RELAXED);
+			}
+			ready_lock.unlock_irqrestore(flags);
+			if (!item) break;
+
+			item->handle.resume();
+			++batch;
+		}
+
+		resumed += batch;
+		if (batch > max_batch) max_batch = batch;
+	}
+}
+
+void kernel::async::init() {
+	// device IRQs and the HPET only go to the bootstrap CPU, so keep the coroutines next to them
+	sched::spawn("async", &run, nullptr, 1);
+
+	kdbgln("Async executor initialized");
+}
+
+void kernel::async::post(Resumable* item) {
+	item->next = nullptr;
+
+	const auto flags = ready_lock.lock_irqsave();
+	__atomic_store_n(&item->queued, true, __ATOMIC_RELAXED);
+	if (ready_tail) {
+		ready_tail->next = item;
+	} else {
+		__atomic_store_n(&ready_head, item, __ATOMIC_RELEASE);
+	}
+	ready_tail = item;
+	ready_lock.unlock_irqrestore(flags);
+
+	ready_queue.wake_one();
+}
+
+void kernel::async::Resumable::cancel() {
+	const auto flags = ready_lock.lock_irqsave();
+	if (queued) {
+		// could be in either list, and the ready one needs its tail kept right
+		Resumable* prev = nullptr;
+		auto** it = &ready_head;
+		while (*it && *it != this) {
+			prev = *it;
+			it = &(*it)->next;
+		}
+		if (*it) {
+			*it = next;
+			if (ready_tail == this) ready_tail = prev;
+		} else {
+			it = &batch_head;
+			while (*it != this) it = &(*it)->next;
+			*it = next;
+		}
+		__atomic_store_n(&queued, false, __ATOMIC_RELAXED);
+	}
+	ready_lock.unlock_irqrestore(flags);
+}
+
+void kernel::async::spawn(Task<void>&& task) {
+	auto handle = task.release();
+	auto& promise = handle.promise();
+	promise.detached = true;
+	promise.start.handle = handle;
+	post(&promise.start);
+}
+
+void kernel::async::dump_stats() {
+	kdbgln("[async] {} resumed, {} at most in one go", resumed, max_batch);
+	frame_pool::dump_stats();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stl/types.hpp>
+#include <kernel/async/task.hpp>
+
+namespace kernel::async {
+
+// Starts the executor thread, which resumes coroutines as they become ready.
+// Must be called after `sched::init`. Tasks spawned before this just wait for it.
+void init();
+
+// Queues a coroutine to be resumed on the executor thread.
+// Safe from interrupt handlers, and from any CPU.
+void post(Resumable* item);
+
+// Runs a task on the executor with nothing awaiting it. It frees itself once done.
+void spawn(Task<void>&& task);
+
+// Suspends the awaiting coroutine and resumes it on the executor thread.
+// Lets code running elsewhere hop onto the executor.
+struct Yield {
+	Resumable resumable;
+
+	bool await_ready() noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> handle) noexcept {
+		resumable.handle = handle;
+		post(&resumable);
+	}
+	void await_resume() noexcept {}
+};
+
+inline Yield yield() { return {}; }
+
+// Prints the executor and frame pool stats over serial.
+void dump_stats();
+
+}
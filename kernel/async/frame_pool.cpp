@@ -0,0 +1,86 @@
+#include <kernel/async/frame_pool.hpp>
+#include <kernel/memory/allocator.hpp>
+#include <kernel/sync/spinlock.hpp>
+#include <kernel/log.hpp>
+
+using namespace kernel;
+using namespace kernel::async;
+
+static constexpr usize CLASS_COUNT = 7;
+static_assert(frame_pool::MIN_FRAME_SIZE << (CLASS_COUNT - 1) == frame_pool::MAX_FRAME_SIZE);
+static_assert(frame_pool::MAX_FRAME_SIZE <= PAGE_SIZE);
+
+struct FreeBlock {
+	FreeBlock* next;
+};
+
+struct SizeClass {
+	FreeBlock* free = nullptr;
+	usize in_use = 0;
+	usize peak = 0;
+	usize pages = 0;
+	sync::SpinLock lock;
+};
+
+static SizeClass classes[CLASS_COUNT];
+
+static usize class_index(usize size) {
+	usize index = 0;
+	while ((frame_pool::MIN_FRAME_SIZE << index) < size) {
+		++index;
+	}
+	return index;
+}
+
+// must be called with the lock of `pool` held
+static void push_free(SizeClass& pool, void* ptr) {
+	auto* block = static_cast<FreeBlock*>(ptr);
+	block->next = pool.free;
+	pool.free = block;
+}
+
+void* kernel::async::frame_pool::allocate(usize size) {
+	if (size > MAX_FRAME_SIZE) {
+		panic("Coroutine frame too big ({} bytes, max is {})", size, MAX_FRAME_SIZE);
+	}
+	const auto index = class_index(size);
+	const auto block_size = MIN_FRAME_SIZE << index;
+	auto& pool = classes[index];
+
+	pool.lock.lock();
+	while (!pool.free) {
+		// allocating a page may send TLB shootdowns, so don't do it with the lock held
+		pool.lock.unlock();
+		auto* page = static_cast<u8*>(alloc::allocate_page());
+		pool.lock.lock();
+
+		for (usize offset = 0; offset + block_size <= PAGE_SIZE; offset += block_size) {
+			push_free(pool, page + offset);
+		}
+		++pool.pages;
+	}
+
+	auto* block = pool.free;
+	pool.free = block->next;
+	if (++pool.in_use > pool.peak) pool.peak = pool.in_use;
+	pool.lock.unlock();
+
+	return block;
+}
+
+void kernel::async::frame_pool::free(void* ptr, usize size) {
+	auto& pool = classes[class_index(size)];
+	pool.lock.lock();
+	push_free(pool, ptr);
+	--pool.in_use;
+	pool.lock.unlock();
+}
+
+void kernel::async::frame_pool::dump_stats() {
+	kdbgln("[frames] size, in use, peak, pages");
+	for (usize index = 0; index < CLASS_COUNT; ++index) {
+		const auto& pool = classes[index];
+		if (!pool.pages) continue;
+		kdbgln("[frames] {}: {}, {}, {}", MIN_FRAME_SIZE << index, pool.in_use, pool.peak, pool.pages);
+	}
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stl/types.hpp>
+
+namespace kernel::async::frame_pool {
+
+// Coroutine frames are rounded up to a power of two, from this up to a whole page.
+// Anything bigger than a page is a bug (probably a big array in a coroutine's locals).
+static constexpr usize MIN_FRAME_SIZE = 64;
+static constexpr usize MAX_FRAME_SIZE = 4096;
+
+// Allocates a coroutine frame. Each size class keeps a free list of blocks carved
+// out of whole pages, so once warmed up this never goes to the page allocator.
+// Must not be called with interrupts disabled, refilling may need to map a page.
+void* allocate(usize size);
+
+// Returns a frame to its size class. Pages are never given back.
+void free(void* ptr, usize size);
+
+// Prints how many frames of each size are in use over serial.
+void dump_stats();
+
+}
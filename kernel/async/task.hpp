@@ -0,0 +1,151 @@
+#pragma once
+
+#include <stl/coroutine.hpp>
+#include <stl/memory.hpp>
+#include <stl/types.hpp>
+#include <stl/utils.hpp>
+#include <kernel/async/frame_pool.hpp>
+#include <kernel/log.hpp>
+
+namespace kernel::async {
+
+// A suspended coroutine waiting for the executor to resume it. Lives in the
+// frame of whatever is waiting, so queueing it up never allocates.
+struct Resumable {
+	Resumable* next = nullptr;
+	std::coroutine_handle<> handle;
+	// set from when it's posted until the executor takes it to resume it
+	bool queued = false;
+
+	// the frame may go away while this is still posted, like when a task gets
+	// destroyed after whatever it was waiting on already woke it up
+	~Resumable() {
+		if (__atomic_load_n(&queued, __ATOMIC_ACQUIRE)) cancel();
+	}
+
+	// Takes it back off the executor's ready list, if it's still on there.
+	void cancel();
+};
+
+template <class T>
+class Task;
+
+namespace impl {
+
+struct PromiseBase {
+	// resumed as soon as the task finishes, if something is awaiting it
+	std::coroutine_handle<> continuation;
+	// spawned tasks have nothing awaiting them, so they free themselves
+	bool detached = false;
+	// used to get a spawned task going on the executor
+	Resumable start;
+
+	static void* operator new(usize size) { return frame_pool::allocate(size); }
+	static void operator delete(void* ptr, usize size) { frame_pool::free(ptr, size); }
+
+	// tasks are lazy, nothing runs until they are awaited or spawned
+	std::suspend_always initial_suspend() noexcept { return {}; }
+
+	struct FinalAwaiter {
+		bool await_ready() noexcept { return false; }
+
+		template <class Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+			auto& promise = handle.promise();
+			// jumping straight to the continuation, instead of resuming it from in here,
+			// keeps long chains of tasks from piling up on the stack
+			if (promise.continuation) return promise.continuation;
+			if (promise.detached) handle.destroy();
+			return std::noop_coroutine();
+		}
+
+		void await_resume() noexcept {}
+	};
+
+	FinalAwaiter final_suspend() noexcept { return {}; }
+
+	// there are no exceptions in the kernel, but the compiler still wants this
+	void unhandled_exception() { panic("Unhandled exception in a coroutine"); }
+};
+
+template <class T>
+struct Promise : PromiseBase {
+	union {
+		T value;
+	};
+	bool has_value = false;
+
+	Promise() {}
+	~Promise() {
+		if (has_value) value.~T();
+	}
+
+	Task<T> get_return_object();
+
+	void return_value(const T& result) {
+		new (&value) T(result);
+		has_value = true;
+	}
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+	Task<void> get_return_object();
+
+	void return_void() {}
+};
+
+}
+
+// A coroutine that produces a T. Tasks start suspended, and only run once
+// awaited (resuming whoever awaited it when done) or spawned on the executor.
+// The frame is owned by the Task, and comes from the frame pool.
+template <class T = void>
+class [[nodiscard]] Task {
+public:
+	using promise_type = impl::Promise<T>;
+	using Handle = std::coroutine_handle<promise_type>;
+
+private:
+	Handle m_handle;
+
+public:
+	explicit Task(Handle handle) : m_handle(handle) {}
+	Task(Task&& other) : m_handle(other.m_handle) { other.m_handle = nullptr; }
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+	~Task() {
+		if (m_handle) m_handle.destroy();
+	}
+
+	bool await_ready() const noexcept { return false; }
+
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+		m_handle.promise().continuation = awaiting;
+		return m_handle;
+	}
+
+	T await_resume() {
+		if constexpr (!mat::types::is_same<T, void>) {
+			return static_cast<T&&>(m_handle.promise().value);
+		}
+	}
+
+	// Gives up ownership of the frame, for the executor to run it detached.
+	Handle release() {
+		auto handle = m_handle;
+		m_handle = nullptr;
+		return handle;
+	}
+};
+
+template <class T>
+Task<T> impl::Promise<T>::get_return_object() {
+	return Task<T>(Task<T>::Handle::from_promise(*this));
+}
+
+inline Task<void> impl::Promise<void>::get_return_object() {
+	return Task<void>(Task<void>::Handle::from_promise(*this));
+}
+
+}
@@ -0,0 +1,29 @@
+#include <kernel/async/timer.hpp>
+#include <kernel/async/executor.hpp>
+#include <kernel/time/time.hpp>
+
+using namespace kernel;
+using namespace kernel::async;
+
+bool kernel::async::Sleep::await_ready() noexcept {
+	return time::monotonic_ns() >= m_deadline_ns;
+}
+
+void kernel::async::Sleep::await_suspend(std::coroutine_handle<> handle) noexcept {
+	m_resumable.handle = handle;
+	m_timer.context = &m_resumable;
+	// runs in the clock event interrupt, so just hand it over to the executor
+	m_timer.callback = [](time::Timer* timer) {
+		post(static_cast<Resumable*>(timer->context));
+	};
+	m_timer.expires_ms = time::expires_ms_for(m_deadline_ns);
+	time::add_timer(&m_timer);
+}
+
+Sleep kernel::async::sleep_until(u64 deadline_ns) {
+	return Sleep(deadline_ns);
+}
+
+Sleep kernel::async::sleep_for(u64 duration_ns) {
+	return Sleep(time::monotonic_ns() + duration_ns);
+}
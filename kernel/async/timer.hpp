@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stl/types.hpp>
+#include <kernel/async/task.hpp>
+#include <kernel/time/timer_wheel.hpp>
+
+namespace kernel::async {
+
+// Suspends the awaiting coroutine until `deadline_ns` (in the same base as
+// `time::monotonic_ns`), then resumes it on the executor. The timer lives in the
+// coroutine frame, so nothing is allocated and no thread sits blocked on it.
+// It goes on the timer wheel, so it may oversleep by up to a millisecond.
+class Sleep {
+	u64 m_deadline_ns;
+	time::Timer m_timer;
+	Resumable m_resumable;
+
+public:
+	explicit Sleep(u64 deadline_ns) : m_deadline_ns(deadline_ns) {}
+	// the task may get destroyed while sleeping, which must not leave the timer behind
+	~Sleep() { time::del_timer_sync(&m_timer); }
+
+	bool await_ready() noexcept;
+	void await_suspend(std::coroutine_handle<> handle) noexcept;
+	void await_resume() noexcept {}
+};
+
+// co_await these to sleep without blocking the executor.
+Sleep sleep_until(u64 deadline_ns);
+Sleep sleep_for(u64 duration_ns);
+
+}
@@ -0,0 +1,39 @@
+#include <kernel/bench/bench.hpp>
+#include <kernel/sched/scheduler.hpp>
+#include <kernel/sync/wait_queue.hpp>
+#include <kernel/log.hpp>
+
+using namespace kernel;
+
+static sync::WaitQueue finished_queue;
+static usize finished = 0;
+
+void kernel::bench::run_all() {
+	// the benchmarks read the stats of the CPU they run on, so don't move around
+	sched::set_affinity(1);
+
+	kdbgln("[bench] starting");
+	context_switch();
+	load_balance();
+	deadline_latency();
+	idle_wakeup();
+	kdbgln("[bench] done");
+}
+
+void kernel::bench::spin(u64 iterations) {
+	for (u64 i = 0; i < iterations; ++i) {
+		// keeps the loop from being optimized out
+		asm volatile("" : : : "memory");
+	}
+}
+
+void kernel::bench::finish() {
+	__atomic_fetch_add(&finished, 1, __ATOMIC_RELEASE);
+	finished_queue.wake_all();
+}
+
+void kernel::bench::wait_finished(usize count) {
+	finished_queue.wait_until([=] { return __atomic_load_n(&finished, __ATOMIC_ACQUIRE) == count; });
+	// everything that was going to finish has, so nothing else touches it
+	finished = 0;
+}
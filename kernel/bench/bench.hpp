@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stl/types.hpp>
+
+// In-kernel benchmarks, only run when built with -DKERNEL_BENCHMARKS=ON.
+// Results get printed over serial.
+namespace kernel::bench {
+
+// Runs every benchmark one after the other. Must be called from a thread.
+void run_all();
+
+// Busy loops for `iterations` rounds, without it getting optimized out.
+void spin(u64 iterations);
+
+// Called by a benchmark's threads once they're done.
+void finish();
+
+// Waits until `count` threads called `finish`, then starts counting from 0 again
+// for the next benchmark.
+void wait_finished(usize count);
+
+// Measures the cost of switching between two threads that keep yielding to each other.
+void context_switch();
+
+// Runs CPU bound and I/O bound threads on every CPU at once, measuring how evenly the
+// work gets spread and how long the I/O bound ones wait to run after waking up.
+void load_balance();
+
+// Measures how late a periodic thread wakes up while every CPU is kept busy,
+// once in the fair class and once in the deadline class.
+void deadline_latency();
+
+// Measures how long an idle CPU takes to run a thread woken up from another CPU,
+// once waiting with mwait (if supported) and once with hlt.
+void idle_wakeup();
+
+}
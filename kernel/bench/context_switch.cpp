@@ -0,0 +1,35 @@
+#include <kernel/bench/bench.hpp>
+#include <kernel/sched/scheduler.hpp>
+#include <kernel/time/time.hpp>
+#include <kernel/cpu.hpp>
+#include <kernel/log.hpp>
+#include <kernel/intrinsics.hpp>
+
+using namespace kernel;
+
+static constexpr usize ITERATIONS = 100'000;
+
+static void ping_pong(void*) {
+	for (usize i = 0; i < ITERATIONS; ++i) {
+		sched::yield();
+	}
+	bench::finish();
+}
+
+void kernel::bench::context_switch() {
+	const auto& state = this_cpu()->sched;
+	const auto switches_before = state.switch_count;
+	const auto cycles_before = state.switch_total_cycles;
+
+	const auto start = time::ordered_cycles();
+	// both on the bootstrap CPU, otherwise they'd each get a CPU to themselves
+	sched::spawn("ping", &ping_pong, nullptr, 1);
+	sched::spawn("pong", &ping_pong, nullptr, 1);
+	bench::wait_finished(2);
+	const auto total = time::ordered_cycles() - start;
+
+	const auto switches = state.switch_count - switches_before;
+	const auto switch_cycles = state.switch_total_cycles - cycles_before;
+	kdbgln("[bench] context switch: {} switches, {} cycles per yield, {} cycles in switch_context",
+		switches, total / (2 * ITERATIONS), switches ? switch_cycles / switches : 0);
+}
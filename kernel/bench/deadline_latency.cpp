@@ -0,0 +1,95 @@
+#include <kernel/bench/bench.hpp>
+#include <kernel/sched/scheduler.hpp>
+#include <kernel/time/time.hpp>
+#include <kernel/smp.hpp>
+#include <kernel/log.hpp>
+#include <kernel/intrinsics.hpp>
+
+using namespace kernel;
+using namespace kernel::bench;
+
+// something like a 250 Hz input or frame loop, that needs a bit of CPU every period
+static constexpr u64 PERIOD_NS = 4'000'000;
+static constexpr u64 RUNTIME_NS = 500'000;
+static constexpr usize ROUNDS = 250;
+static constexpr u64 WORK_ITERATIONS = 10'000;
+
+// background threads that never block, keeping every CPU busy
+static constexpr usize HOGS_PER_CPU = 2;
+static constexpr u64 HOG_ITERATIONS = 100'000;
+
+struct LatencyResult {
+	bool deadline = false;
+	bool admitted = true;
+	u64 total_ns = 0;
+	u64 max_ns = 0;
+	u64 throttles = 0;
+	u64 misses = 0;
+};
+static bool stop_hogs = false;
+
+static void hog(void*) {
+	while (!__atomic_load_n(&stop_hogs, __ATOMIC_RELAXED)) {
+		spin(HOG_ITERATIONS);
+	}
+	finish();
+}
+
+static void periodic(void* arg) {
+	auto& result = *static_cast<LatencyResult*>(arg);
+	if (result.deadline && !sched::set_deadline({ RUNTIME_NS, PERIOD_NS, PERIOD_NS })) {
+		result.admitted = false;
+	}
+
+	auto next = time::monotonic_ns() + PERIOD_NS;
+	for (usize i = 0; i < ROUNDS && result.admitted; ++i) {
+		const auto now = time::monotonic_ns();
+		if (next > now) {
+			sleep_for(next - now);
+		}
+		const auto latency = time::monotonic_ns() - next;
+		result.total_ns += latency;
+		if (latency > result.max_ns) result.max_ns = latency;
+
+		spin(WORK_ITERATIONS);
+		next += PERIOD_NS;
+	}
+
+	if (result.deadline && result.admitted) {
+		const auto* thread = sched::current();
+		result.throttles = thread->deadline.throttles;
+		result.misses = thread->deadline.misses;
+		sched::clear_deadline();
+	}
+
+	__atomic_store_n(&stop_hogs, true, __ATOMIC_RELAXED);
+	finish();
+}
+
+static void run(LatencyResult& result) {
+	const auto hogs = smp::online_count() * HOGS_PER_CPU;
+
+	stop_hogs = false;
+	for (usize i = 0; i < hogs; ++i) {
+		sched::spawn("hog", &hog);
+	}
+	sched::spawn("periodic", &periodic, &result);
+	wait_finished(hogs + 1);
+
+	if (!result.admitted) {
+		kdbgln("[bench] deadline latency: not admitted");
+		return;
+	}
+	kdbgln("[bench] deadline latency: {} class, {} hogs, wake up latency avg {} ns, max {} ns, {} throttles, {} misses",
+		result.deadline ? "deadline" : "fair", hogs, result.total_ns / ROUNDS, result.max_ns, result.throttles, result.misses);
+}
+
+void kernel::bench::deadline_latency() {
+	// the same periodic thread, first competing with the hogs as an equal, then ahead of them
+	LatencyResult fair;
+	run(fair);
+
+	LatencyResult deadline;
+	deadline.deadline = true;
+	run(deadline);
+}
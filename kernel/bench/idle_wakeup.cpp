@@ -0,0 +1,73 @@
+#include <kernel/bench/bench.hpp>
+#include <kernel/sched/scheduler.hpp>
+#include <kernel/sync/wait_queue.hpp>
+#include <kernel/time/time.hpp>
+#include <kernel/smp.hpp>
+#include <kernel/idle.hpp>
+#include <kernel/log.hpp>
+#include <kernel/intrinsics.hpp>
+
+using namespace kernel;
+
+static constexpr usize ROUNDS = 500;
+// long enough for the sleeper's CPU to have gone idle again before the next wake up
+static constexpr u64 GAP_NS = 200'000;
+
+static sync::WaitQueue wake_queue;
+static bool pending = false;
+// when the waker woke the sleeper, the TSC is synchronized between CPUs
+static u64 wake_tsc = 0;
+
+static u64 total_cycles = 0;
+static u64 max_cycles = 0;
+
+static void sleeper(void*) {
+	for (usize i = 0; i < ROUNDS; ++i) {
+		wake_queue.wait_until([] { return __atomic_load_n(&pending, __ATOMIC_ACQUIRE); });
+		const auto cycles = rdtsc() - __atomic_load_n(&wake_tsc, __ATOMIC_RELAXED);
+		total_cycles += cycles;
+		if (cycles > max_cycles) max_cycles = cycles;
+		__atomic_store_n(&pending, false, __ATOMIC_RELEASE);
+	}
+
+	bench::finish();
+}
+
+static void run(bool mwait) {
+	idle::set_mwait(mwait);
+	total_cycles = 0;
+	max_cycles = 0;
+
+	// the benchmark thread stays on CPU 0, the sleeper gets CPU 1 to itself
+	sched::spawn("sleeper", &sleeper, nullptr, u64(1) << 1);
+	for (usize i = 0; i < ROUNDS; ++i) {
+		sleep_for(GAP_NS);
+		__atomic_store_n(&wake_tsc, rdtsc(), __ATOMIC_RELAXED);
+		__atomic_store_n(&pending, true, __ATOMIC_RELEASE);
+		wake_queue.wake_all();
+
+		while (__atomic_load_n(&pending, __ATOMIC_ACQUIRE)) {
+			sched::yield();
+		}
+	}
+	bench::wait_finished(1);
+
+	kdbgln("[bench] idle wake up: {}, wake up to running avg {} ns, max {} ns", mwait ? "mwait" : "hlt",
+		time::cycles_to_ns(total_cycles / ROUNDS), time::cycles_to_ns(max_cycles));
+}
+
+void kernel::bench::idle_wakeup() {
+	if (smp::online_count() < 2) {
+		kdbgln("[bench] idle wake up: needs at least 2 CPUs");
+		return;
+	}
+
+	const bool had_mwait = idle::using_mwait();
+	if (had_mwait) {
+		run(true);
+	} else {
+		kdbgln("[bench] idle wake up: mwait isn't supported, only measuring hlt");
+	}
+	run(false);
+	idle::set_mwait(had_mwait);
+}
@@ -0,0 +1,103 @@
+#include <kernel/bench/bench.hpp>
+#include <kernel/sched/scheduler.hpp>
+#include <kernel/time/time.hpp>
+#include <kernel/smp.hpp>
+#include <kernel/cpu.hpp>
+#include <kernel/log.hpp>
+#include <kernel/intrinsics.hpp>
+
+using namespace kernel;
+using namespace kernel::bench;
+
+static constexpr usize CPU_BOUND_PER_CPU = 2;
+static constexpr u64 CPU_BOUND_ITERATIONS = 50'000'000;
+
+// these mostly sleep, doing a little bit of work every time they wake up
+static constexpr usize IO_BOUND_PER_CPU = 1;
+static constexpr usize IO_ROUNDS = 200;
+static constexpr u64 IO_SLEEP_NS = 1'000'000;
+static constexpr u64 IO_ITERATIONS = 10'000;
+
+// how long after their sleep ended the I/O bound threads got to run again
+static u64 total_wake_latency_ns = 0;
+static u64 max_wake_latency_ns = 0;
+
+struct CPUSnapshot {
+	u64 idle_cycles;
+	u64 steals;
+	u64 pulls;
+};
+
+static void cpu_bound(void*) {
+	spin(CPU_BOUND_ITERATIONS);
+	finish();
+}
+
+static void io_bound(void*) {
+	for (usize i = 0; i < IO_ROUNDS; ++i) {
+		const auto deadline = time::monotonic_ns() + IO_SLEEP_NS;
+		sleep_for(IO_SLEEP_NS);
+		const auto latency = time::monotonic_ns() - deadline;
+
+		__atomic_fetch_add(&total_wake_latency_ns, latency, __ATOMIC_RELAXED);
+		auto max = __atomic_load_n(&max_wake_latency_ns, __ATOMIC_RELAXED);
+		while (latency > max && !__atomic_compare_exchange_n(&max_wake_latency_ns, &max, latency, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+		spin(IO_ITERATIONS);
+	}
+	finish();
+}
+
+static CPUSnapshot snapshot(const CPU* cpu) {
+	const auto& state = cpu->sched;
+	// the idle thread's runtime only gets added up when switching away from it
+	auto idle_cycles = state.idle->runtime_cycles;
+	if (__atomic_load_n(&state.current, __ATOMIC_RELAXED) == state.idle) {
+		idle_cycles += rdtsc() - state.idle->last_switch_in;
+	}
+	return { idle_cycles, state.steals, state.pulls };
+}
+
+void kernel::bench::load_balance() {
+	const auto cpus = smp::online_count();
+	const auto cpu_bound_count = cpus * CPU_BOUND_PER_CPU;
+	const auto io_bound_count = cpus * IO_BOUND_PER_CPU;
+
+	static CPUSnapshot before[MAX_CPUS];
+	for (u32 id = 0; id < cpu::count(); ++id) {
+		const auto* cpu = cpu::get(id);
+		if (cpu->sched.idle) {
+			before[id] = snapshot(cpu);
+		}
+	}
+
+	total_wake_latency_ns = 0;
+	max_wake_latency_ns = 0;
+
+	const auto start = rdtsc();
+	// everything starts out on this CPU, the others have to come and take it
+	for (usize i = 0; i < cpu_bound_count; ++i) {
+		sched::spawn("cpu-bound", &cpu_bound);
+	}
+	for (usize i = 0; i < io_bound_count; ++i) {
+		sched::spawn("io-bound", &io_bound);
+	}
+	wait_finished(cpu_bound_count + io_bound_count);
+	const auto total = rdtsc() - start;
+
+	kdbgln("[bench] load balance: {} CPUs, {} CPU bound and {} I/O bound threads, {} cycles",
+		cpus, cpu_bound_count, io_bound_count, total);
+	kdbgln("[bench] load balance: I/O wake up latency avg {} ns, max {} ns",
+		total_wake_latency_ns / (io_bound_count * IO_ROUNDS), max_wake_latency_ns);
+
+	for (u32 id = 0; id < cpu::count(); ++id) {
+		const auto* cpu = cpu::get(id);
+		if (!cpu->sched.idle) continue;
+
+		const auto after = snapshot(cpu);
+		const auto idle = after.idle_cycles - before[id].idle_cycles;
+		const auto busy_percent = idle < total ? 100 - idle * 100 / total : 0;
+		kdbgln("[bench] load balance: cpu {}: {}% busy, {} stolen, {} pulled",
+			id, busy_percent, after.steals - before[id].steals, after.pulls - before[id].pulls);
+	}
+}
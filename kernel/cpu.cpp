@@ -0,0 +1,55 @@
+#include <stl/memory.hpp>
+#include <kernel/cpu.hpp>
+#include <kernel/memory/allocator.hpp>
+#include <kernel/log.hpp>
+#include <kernel/intrinsics.hpp>
+
+using namespace kernel;
+
+static constexpr u32 IA32_GS_BASE_MSR = 0xC0000101;
+
+constinit static CPU bsp_cpu;
+
+static CPU* cpus[MAX_CPUS];
+static usize cpu_count = 0;
+
+void kernel::cpu::init_current(CPU* cpu) {
+	gdt::load(&cpu->gdt, cpu->double_fault_stack + sizeof(cpu->double_fault_stack));
+	// loading the GDT cleared gs, so this has to come after
+	wrmsr(IA32_GS_BASE_MSR, reinterpret_cast<uptr>(cpu));
+}
+
+void kernel::cpu::init_bsp() {
+	bsp_cpu.self = &bsp_cpu;
+	bsp_cpu.id = 0;
+	bsp_cpu.online = true;
+	cpus[cpu_count++] = &bsp_cpu;
+
+	init_current(&bsp_cpu);
+}
+
+CPU* kernel::cpu::create(u32 lapic_id) {
+	if (cpu_count >= MAX_CPUS) {
+		panic("Too many CPUs");
+	}
+
+	static constexpr auto CPU_PAGES = (sizeof(CPU) + PAGE_SIZE - 1) / PAGE_SIZE;
+	auto* cpu = new (alloc::allocate_pages(CPU_PAGES)) CPU();
+	cpu->self = cpu;
+	cpu->id = cpu_count;
+	cpu->lapic_id = lapic_id;
+
+	auto* stack = static_cast<u8*>(alloc::allocate_pages(KERNEL_STACK_SIZE / PAGE_SIZE));
+	cpu->stack_top = stack + KERNEL_STACK_SIZE;
+
+	cpus[cpu_count++] = cpu;
+	return cpu;
+}
+
+CPU* kernel::cpu::get(u32 id) {
+	return id < cpu_count ? cpus[id] : nullptr;
+}
+
+usize kernel::cpu::count() {
+	return cpu_count;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stl/types.hpp>
+#include <kernel/gdt.hpp>
+#include <kernel/deferred.hpp>
+#include <kernel/irq_stats.hpp>
+#include <kernel/irq_trace.hpp>
+#include <kernel/idle.hpp>
+#include <kernel/fpu.hpp>
+#include <kernel/memory/tlb.hpp>
+#include <kernel/sched/thread.hpp>
+#include <kernel/sync/rcu.hpp>
+#include <kernel/time/clock_event.hpp>
+#include <kernel/time/timer_wheel.hpp>
+
+namespace kernel {
+
+static constexpr usize MAX_CPUS = 64;
+static constexpr usize KERNEL_STACK_SIZE = 16 * 1024;
+
+// Data private to a single CPU, reached through the GS base.
+// Only the owning CPU should write to it, others may read it for stats.
+// The exceptions are the run queue, timer queue and timer wheel, which have their own locks,
+// the RCU callback list, which other CPUs take atomically, and the idle wake up fields.
+struct CPU {
+	// points back to this, so that `this_cpu` is a single load off of gs
+	CPU* self = nullptr;
+	// index into the CPU list, the bootstrap CPU is always 0
+	u32 id = 0;
+	u32 lapic_id = 0;
+	bool online = false;
+	// top of the kernel stack this CPU started on, null for the bootstrap CPU
+	// which just keeps using limine's stack
+	void* stack_top = nullptr;
+
+	gdt::GDT gdt;
+	alignas(16) u8 double_fault_stack[4096] = {};
+
+	deferred::WorkQueue deferred_work;
+	irq_trace::CPUState irq_trace;
+	irq_stats::VectorStats irq_stats[256];
+	tlb::CPUStats tlb_stats;
+	time::CPUTimers timers;
+	time::TimerWheel timer_wheel;
+	sched::CPUState sched;
+	rcu::CPUState rcu;
+	idle::CPUState idle;
+	fpu::CPUState fpu;
+};
+
+// The CPU this is running on. Threads may move to another CPU whenever they get switched out,
+// so this only stays the same while preemption or interrupts are disabled.
+inline CPU* this_cpu() {
+	CPU* cpu;
+	asm volatile("movq %%gs:0, %0" : "=r"(cpu));
+	return cpu;
+}
+
+namespace cpu {
+
+// Sets up the GDT, TSS and per-CPU data for the bootstrap CPU.
+// Has to be the very first thing, since everything else may use `this_cpu`.
+void init_bsp();
+
+// Allocates the per-CPU data and stack for another CPU, it still has to be started
+// and call `init_current` itself.
+CPU* create(u32 lapic_id);
+
+// Loads the GDT and TSS of `cpu` and points the GS base at it, on the calling CPU.
+void init_current(CPU* cpu);
+
+// The CPU with the given id, or null.
+CPU* get(u32 id);
+
+// How many CPUs there are, including ones that haven't started yet.
+usize count();
+
+}
+
+}
@@ -1,4 +1,6 @@
 #include <stl/types.hpp>
+#include <kernel/dispatch.hpp>
+#include <kernel/intrinsics.hpp>
 
 extern "C" {
 	// https://libcxxabi.llvm.org/spec.html
@@ -13,4 +15,41 @@ extern "C" {
 		// Effects: Sets the first byte of the guard object to a non-zero value.
 		*reinterpret_cast<u8*>(guard) = 0x44;
 	}
-}
\ No newline at end of file
+}
+
+// gcc expects these to exist even when freestanding, for things like zeroing or copying big structs.
+// memset and memcpy go through the dispatch table, which picks the best rep string variant for the CPU
+extern "C" {
+	void* memset(void* dest, int value, usize count) {
+		return kernel::dispatch::table.memset(dest, value, count);
+	}
+
+	void* memcpy(void* dest, const void* src, usize count) {
+		return kernel::dispatch::table.memcpy(dest, src, count);
+	}
+
+	void* memmove(void* dest, const void* src, usize count) {
+		if (dest <= src || static_cast<const u8*>(src) + count <= dest) {
+			return memcpy(dest, src, count);
+		}
+		// overlapping with dest after src, so copy backwards. interrupts are kept off
+		// while the direction flag is set, so it can't leak into a handler or another thread
+		auto* ptr = static_cast<u8*>(dest) + count - 1;
+		src = static_cast<const u8*>(src) + count - 1;
+		const auto flags = irq_save();
+		asm volatile("std; rep movsb; cld" : "+D"(ptr), "+S"(src), "+c"(count) : : "memory");
+		irq_restore(flags);
+		return dest;
+	}
+
+	int memcmp(const void* lhs, const void* rhs, usize count) {
+		const auto* a = static_cast<const u8*>(lhs);
+		const auto* b = static_cast<const u8*>(rhs);
+		for (usize i = 0; i < count; ++i) {
+			if (a[i] != b[i]) {
+				return a[i] < b[i] ? -1 : 1;
+			}
+		}
+		return 0;
+	}
+}
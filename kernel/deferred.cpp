@@ -0,0 +1,59 @@
+#include <kernel/deferred.hpp>
+#include <kernel/cpu.hpp>
+#include <kernel/intrinsics.hpp>
+
+using namespace kernel::deferred;
+
+// must be called with interrupts disabled
+static Work* pop(WorkQueue& work_queue) {
+	auto* work = work_queue.head;
+	if (!work) return nullptr;
+
+	work_queue.head = work->next;
+	if (!work_queue.head) {
+		work_queue.tail = nullptr;
+	}
+	work->next = nullptr;
+	__atomic_store_n(&work->queued, false, __ATOMIC_RELEASE);
+	return work;
+}
+
+bool kernel::deferred::queue(Work* work) {
+	// another CPU may be queueing the same work, only one of them gets to
+	if (__atomic_exchange_n(&work->queued, true, __ATOMIC_ACQ_REL)) {
+		return false;
+	}
+
+	const auto flags = irq_save();
+	auto& work_queue = kernel::this_cpu()->deferred_work;
+	work->next = nullptr;
+	if (work_queue.tail) {
+		work_queue.tail->next = work;
+	} else {
+		work_queue.head = work;
+	}
+	work_queue.tail = work;
+
+	irq_restore(flags);
+	return true;
+}
+
+void kernel::deferred::run_pending() {
+	const auto flags = irq_save();
+	auto& work_queue = kernel::this_cpu()->deferred_work;
+	if (work_queue.running || !work_queue.head) {
+		irq_restore(flags);
+		return;
+	}
+
+	work_queue.running = true;
+	while (auto* work = pop(work_queue)) {
+		// taken off the queue first, so it can queue itself again
+		sti();
+		work->func(work);
+		cli();
+	}
+	work_queue.running = false;
+
+	irq_restore(flags);
+}
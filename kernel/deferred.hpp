@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stl/types.hpp>
+
+namespace kernel::deferred {
+
+// A piece of work that an interrupt handler pushed off to run later, with interrupts enabled.
+// Hard IRQ handlers should only acknowledge the device and queue one of these,
+// so that they don't hold up other interrupts.
+// Like timers, these are embedded in whatever owns them, nothing gets allocated.
+// The work still runs on top of an interrupt, so it must not block.
+struct Work {
+	void (*func)(Work* work) = nullptr;
+	void* context = nullptr;
+
+	Work* next = nullptr;
+	bool queued = false;
+};
+
+// Work waiting to run on a CPU, part of the per-CPU data.
+struct WorkQueue {
+	Work* head = nullptr;
+	Work* tail = nullptr;
+	// set while run_pending is going, so nested interrupts leave the work to it
+	bool running = false;
+};
+
+// Queues work to run on this CPU. Safe from interrupt handlers and from any CPU.
+// Returns false if it was already queued, in which case it still only runs once.
+bool queue(Work* work);
+
+// Runs all queued work with interrupts enabled, including anything queued in the meantime.
+// Called on the way out of every IRQ, does nothing if already running further up the stack.
+void run_pending();
+
+}
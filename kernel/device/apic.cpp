@@ -0,0 +1,259 @@
+#include <stl/math.hpp>
+#include <kernel/device/apic.hpp>
+#include <kernel/acpi.hpp>
+#include <kernel/idt.hpp>
+#include <kernel/memory/paging.hpp>
+#include <kernel/log.hpp>
+#include <kernel/features.hpp>
+#include <kernel/intrinsics.hpp>
+
+static constexpr u32 IA32_APIC_BASE_MSR = 0x1B;
+static constexpr u64 APIC_BASE_ENABLE = 1 << 11;
+static constexpr u64 APIC_BASE_X2APIC = 1 << 10;
+static constexpr u32 X2APIC_MSR_BASE = 0x800;
+
+// set while the local APIC is still sending the last IPI, xAPIC only
+static constexpr u32 ICR_DELIVERY_PENDING = 1 << 12;
+
+static constexpr u32 IOAPIC_REG_VERSION = 0x01;
+static constexpr u32 IOAPIC_REG_REDIRECTION = 0x10;
+
+static constexpr u32 REDIRECTION_ACTIVE_LOW = 1 << 13;
+static constexpr u32 REDIRECTION_LEVEL = 1 << 15;
+static constexpr u32 REDIRECTION_MASKED = 1 << 16;
+
+static constexpr usize MAX_IOAPICS = 8;
+
+struct IOAPIC {
+	volatile u32* base = nullptr;
+	u32 gsi_base = 0;
+	u32 gsi_count = 0;
+
+	u32 read(u32 reg) const {
+		base[0] = reg;
+		return base[4];
+	}
+
+	void write(u32 reg, u32 value) const {
+		base[0] = reg;
+		base[4] = value;
+	}
+};
+
+static IOAPIC ioapics[MAX_IOAPICS];
+static usize ioapic_count = 0;
+
+// How each ISA IRQ is wired, after applying the MADT interrupt source overrides.
+// Without an override, ISA IRQs are identity mapped, active high and edge triggered.
+struct ISARoute {
+	u32 gsi = 0;
+	bool active_low = false;
+	bool level_triggered = false;
+};
+
+static ISARoute isa_routes[16];
+
+static volatile u32* lapic_base = nullptr;
+static bool x2apic_mode = false;
+static u32 bsp_lapic_id = 0;
+
+using namespace kernel;
+
+u32 kernel::apic::lapic_read(u32 reg) {
+	if (x2apic_mode)
+		return rdmsr(X2APIC_MSR_BASE + reg / 16);
+	return lapic_base[reg / 4];
+}
+
+void kernel::apic::lapic_write(u32 reg, u32 value) {
+	if (x2apic_mode)
+		wrmsr(X2APIC_MSR_BASE + reg / 16, value);
+	else
+		lapic_base[reg / 4] = value;
+}
+
+void kernel::apic::send_eoi() {
+	// in x2APIC mode this is a single non-serializing wrmsr
+	if (x2apic_mode)
+		wrmsr(X2APIC_MSR_BASE + LAPIC_REG_EOI / 16, 0);
+	else
+		lapic_base[LAPIC_REG_EOI / 4] = 0;
+}
+
+bool kernel::apic::is_x2apic() {
+	return x2apic_mode;
+}
+
+u32 kernel::apic::lapic_id() {
+	const auto value = lapic_read(LAPIC_REG_ID);
+	// xAPIC keeps the id in the top byte
+	return x2apic_mode ? value : value >> 24;
+}
+
+void kernel::apic::send_ipi(u32 target_lapic_id, u8 vector) {
+	// fixed delivery, physical destination, edge triggered
+	if (x2apic_mode) {
+		// in x2APIC mode the ICR is a single 64 bit MSR, so no waiting or tearing.
+		// unlike the MMIO write that wrmsr isn't serializing, so without the fences the IPI
+		// could get to the target before the stores it's meant to announce
+		asm volatile("mfence; lfence" : : : "memory");
+		wrmsr(X2APIC_MSR_BASE + LAPIC_REG_ICR_LOW / 16, (u64(target_lapic_id) << 32) | vector);
+		return;
+	}
+
+	// the two halves must not be split by an interrupt handler sending its own IPI
+	const auto flags = irq_save();
+	while (lapic_read(LAPIC_REG_ICR_LOW) & ICR_DELIVERY_PENDING) {
+		cpu_relax();
+	}
+	lapic_write(LAPIC_REG_ICR_HIGH, target_lapic_id << 24);
+	// writing the low half is what sends it
+	lapic_write(LAPIC_REG_ICR_LOW, vector);
+	irq_restore(flags);
+}
+
+static IOAPIC* ioapic_for_gsi(u32 gsi) {
+	for (usize i = 0; i < ioapic_count; ++i) {
+		auto& ioapic = ioapics[i];
+		if (gsi >= ioapic.gsi_base && gsi < ioapic.gsi_base + ioapic.gsi_count)
+			return &ioapic;
+	}
+	return nullptr;
+}
+
+bool kernel::apic::route_gsi(u32 gsi, u8 vector, bool active_low, bool level_triggered, bool masked) {
+	auto* ioapic = ioapic_for_gsi(gsi);
+	if (!ioapic) return false;
+
+	const auto index = gsi - ioapic->gsi_base;
+
+	// fixed delivery, physical destination
+	u32 low = vector;
+	if (active_low) low |= REDIRECTION_ACTIVE_LOW;
+	if (level_triggered) low |= REDIRECTION_LEVEL;
+	if (masked) low |= REDIRECTION_MASKED;
+	// the destination field is only 8 bits without interrupt remapping,
+	// which is fine as the BSP is usually id 0
+	const u32 high = bsp_lapic_id << 24;
+
+	// write the high half first, so the entry is never unmasked with a bogus destination
+	ioapic->write(IOAPIC_REG_REDIRECTION + index * 2 + 1, high);
+	ioapic->write(IOAPIC_REG_REDIRECTION + index * 2, low);
+	return true;
+}
+
+void kernel::apic::set_irq_mask(u8 irq_index, bool enabled) {
+	if (irq_index >= 16) {
+		panic("Invalid ISA IRQ {}", irq_index);
+	}
+
+	const auto& route = isa_routes[irq_index];
+	auto* ioapic = ioapic_for_gsi(route.gsi);
+	if (!ioapic) {
+		panic("No I/O APIC for IRQ {} (GSI {})", irq_index, route.gsi);
+	}
+
+	const auto reg = IOAPIC_REG_REDIRECTION + (route.gsi - ioapic->gsi_base) * 2;
+	auto low = ioapic->read(reg);
+	mat::math::set_bit(low, 16, !enabled);
+	ioapic->write(reg, low);
+}
+
+static void parse_madt(const acpi::MADT* madt) {
+	uptr lapic_phys = madt->lapic_address;
+
+	for (u8 i = 0; i < 16; ++i) {
+		isa_routes[i] = ISARoute { i };
+	}
+
+	acpi::for_each_madt_entry(madt, [&](const acpi::MADTEntry* entry) {
+		const auto* data = reinterpret_cast<const u8*>(entry);
+		switch (entry->type) {
+			case acpi::MADTEntry::Type::IOAPIC: {
+				if (ioapic_count >= MAX_IOAPICS) {
+					kdbgln("[APIC] too many I/O APICs, ignoring one");
+					break;
+				}
+				const auto address = *reinterpret_cast<const u32*>(data + 4);
+				const auto gsi_base = *reinterpret_cast<const u32*>(data + 8);
+
+				auto& ioapic = ioapics[ioapic_count++];
+				ioapic.base = reinterpret_cast<volatile u32*>(PhysicalAddress(address).to_virtual().ptr());
+				ioapic.gsi_base = gsi_base;
+				ioapic.gsi_count = (ioapic.read(IOAPIC_REG_VERSION) >> 16 & 0xFF) + 1;
+				kdbgln("[APIC] I/O APIC at {:#x}, GSIs {}-{}", address, gsi_base, gsi_base + ioapic.gsi_count - 1);
+				break;
+			}
+			case acpi::MADTEntry::Type::InterruptSourceOverride: {
+				const auto bus = data[2];
+				const auto source = data[3];
+				const auto gsi = *reinterpret_cast<const u32*>(data + 4);
+				const auto flags = *reinterpret_cast<const u16*>(data + 8);
+				if (bus != 0 || source >= 16) break;
+
+				// polarity: bits 0-1, trigger mode: bits 2-3. 0b11 means active low / level
+				isa_routes[source] = ISARoute {
+					.gsi = gsi,
+					.active_low = (flags & 0b11) == 0b11,
+					.level_triggered = (flags >> 2 & 0b11) == 0b11,
+				};
+				kdbgln("[APIC] IRQ {} is overridden to GSI {}", source, gsi);
+				break;
+			}
+			case acpi::MADTEntry::Type::LocalAPICAddressOverride: {
+				lapic_phys = *reinterpret_cast<const u64*>(data + 4);
+				break;
+			}
+			default: break;
+		}
+	});
+
+	lapic_base = reinterpret_cast<volatile u32*>(PhysicalAddress(lapic_phys).to_virtual().ptr());
+}
+
+void kernel::apic::init_local() {
+	auto base_msr = rdmsr(IA32_APIC_BASE_MSR) | APIC_BASE_ENABLE;
+	if (x2apic_mode) {
+		base_msr |= APIC_BASE_X2APIC;
+	}
+	wrmsr(IA32_APIC_BASE_MSR, base_msr);
+
+	// accept all priorities
+	lapic_write(LAPIC_REG_TPR, 0);
+	// LINT0 is where the 8259 would deliver its interrupts, so cut it off entirely.
+	// LINT1 is usually wired to NMI, leave that as the firmware set it up
+	lapic_write(LAPIC_REG_LVT_LINT0, LAPIC_LVT_MASKED);
+	lapic_write(LAPIC_REG_LVT_ERROR, LAPIC_LVT_MASKED);
+	lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED);
+	// software enable, and send spurious interrupts to a vector that just ignores them
+	lapic_write(LAPIC_REG_SVR, (1 << 8) | SPURIOUS_VECTOR);
+	// the ESR has to be written before being read
+	lapic_write(LAPIC_REG_ESR, 0);
+	send_eoi();
+}
+
+void kernel::apic::init() {
+	const auto* madt = reinterpret_cast<const acpi::MADT*>(acpi::find_table("APIC"));
+	if (!madt)
+		panic("No MADT found, can't set up the APIC");
+
+	parse_madt(madt);
+
+	if (!ioapic_count)
+		panic("No I/O APIC found in the MADT");
+
+	x2apic_mode = features::has(features::Feature::X2APIC);
+
+	init_local();
+	bsp_lapic_id = lapic_id();
+
+	// route every ISA IRQ to its usual vector, masked until a driver asks for it.
+	// IRQ 2 is the cascade on the 8259, which never fires
+	for (u8 irq = 0; irq < 16; ++irq) {
+		if (irq == 2) continue;
+		const auto& route = isa_routes[irq];
+		route_gsi(route.gsi, IRQ_VECTOR_BASE + irq, route.active_low, route.level_triggered, true);
+	}
+
+	kdbgln("APIC initialized ({} mode, BSP id {})", x2apic_mode ? "x2APIC" : "xAPIC", bsp_lapic_id);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stl/types.hpp>
+
+namespace kernel::apic {
+
+// Local APIC register offsets, as in the xAPIC MMIO layout.
+// In x2APIC mode these get turned into MSRs (0x800 + offset / 16).
+static constexpr u32 LAPIC_REG_ID = 0x20;
+static constexpr u32 LAPIC_REG_VERSION = 0x30;
+static constexpr u32 LAPIC_REG_TPR = 0x80;
+static constexpr u32 LAPIC_REG_EOI = 0xB0;
+static constexpr u32 LAPIC_REG_SVR = 0xF0;
+static constexpr u32 LAPIC_REG_ESR = 0x280;
+static constexpr u32 LAPIC_REG_ICR_LOW = 0x300;
+static constexpr u32 LAPIC_REG_ICR_HIGH = 0x310;
+static constexpr u32 LAPIC_REG_LVT_TIMER = 0x320;
+static constexpr u32 LAPIC_REG_LVT_LINT0 = 0x350;
+static constexpr u32 LAPIC_REG_LVT_LINT1 = 0x360;
+static constexpr u32 LAPIC_REG_LVT_ERROR = 0x370;
+static constexpr u32 LAPIC_REG_TIMER_INITIAL = 0x380;
+static constexpr u32 LAPIC_REG_TIMER_CURRENT = 0x390;
+static constexpr u32 LAPIC_REG_TIMER_DIVIDE = 0x3E0;
+
+static constexpr u32 LAPIC_LVT_MASKED = 1 << 16;
+
+// Parses the MADT, enables the local APIC (x2APIC if available) and
+// routes the legacy ISA IRQs through the I/O APIC, all masked.
+// The 8259 PIC must already be remapped and masked.
+void init();
+
+// Enables the local APIC of the calling CPU, using the mode picked in `init`.
+void init_local();
+
+// Sends an End Of Interrupt to the local APIC, required at the end of IRQs.
+void send_eoi();
+
+// Sends an interrupt on `vector` to the CPU with the given local APIC id.
+void send_ipi(u32 target_lapic_id, u8 vector);
+
+// Masks a legacy ISA IRQ (0-15) to be either enabled or disabled,
+// taking into account the MADT interrupt source overrides.
+void set_irq_mask(u8 irq_index, bool enabled);
+
+// Routes a global system interrupt to a vector on the bootstrap CPU.
+// Returns false if no I/O APIC handles that GSI.
+bool route_gsi(u32 gsi, u8 vector, bool active_low, bool level_triggered, bool masked);
+
+bool is_x2apic();
+
+// The APIC id of the calling CPU
+u32 lapic_id();
+
+u32 lapic_read(u32 reg);
+void lapic_write(u32 reg, u32 value);
+
+}
@@ -0,0 +1,225 @@
+#include <stl/math.hpp>
+#include <kernel/device/hpet.hpp>
+#include <kernel/device/apic.hpp>
+#include <kernel/time/clock_event.hpp>
+#include <kernel/time/time.hpp>
+#include <kernel/acpi.hpp>
+#include <kernel/idt.hpp>
+#include <kernel/memory/paging.hpp>
+#include <kernel/log.hpp>
+
+struct [[gnu::packed]] HPETTable {
+	kernel::acpi::SDTHeader header;
+	u32 event_timer_block_id;
+	// generic address structure
+	u8 address_space_id;
+	u8 register_bit_width;
+	u8 register_bit_offset;
+	u8 reserved;
+	u64 address;
+	u8 hpet_number;
+	u16 minimum_tick;
+	u8 page_protection;
+};
+
+static constexpr u32 REG_CAPABILITIES = 0x000;
+static constexpr u32 REG_CONFIG = 0x010;
+static constexpr u32 REG_MAIN_COUNTER = 0x0F0;
+
+static constexpr u32 timer_config_reg(u32 n) { return 0x100 + 0x20 * n; }
+static constexpr u32 timer_comparator_reg(u32 n) { return 0x108 + 0x20 * n; }
+
+static constexpr u64 CAP_COUNTER_64BIT = 1 << 13;
+static constexpr u64 CONFIG_ENABLE = 1 << 0;
+
+static constexpr u64 TIMER_LEVEL_TRIGGERED = 1 << 1;
+static constexpr u64 TIMER_INT_ENABLE = 1 << 2;
+static constexpr u64 TIMER_PERIODIC = 1 << 3;
+static constexpr u64 TIMER_64BIT_CAPABLE = 1 << 5;
+static constexpr u64 TIMER_32BIT_MODE = 1 << 8;
+static constexpr u32 TIMER_ROUTE_SHIFT = 9;
+static constexpr u64 TIMER_FSB_ENABLE = 1 << 14;
+
+static constexpr u64 FEMTOSECONDS_PER_SEC = 1'000'000'000'000'000;
+
+static volatile u64* hpet_base = nullptr;
+static u32 timer_count = 0;
+
+// which comparator is used for clock events
+static u32 event_timer = 0;
+// comparators can be 32 bits even with a 64 bit counter, then they only match the low half
+static u64 comparator_mask = 0;
+
+static u64 read_reg(u32 reg) {
+	return hpet_base[reg / 8];
+}
+
+static void write_reg(u32 reg, u64 value) {
+	hpet_base[reg / 8] = value;
+}
+
+static u64 read_counter() {
+	return read_reg(REG_MAIN_COUNTER);
+}
+
+// a 64 bit read of a 32 bit counter isn't guaranteed to give zeroes in the upper half
+static u64 read_counter_32() {
+	return reinterpret_cast<volatile u32*>(hpet_base)[REG_MAIN_COUNTER / 4];
+}
+
+static kernel::time::ClockSource hpet_source = {
+	.name = "hpet",
+	// worse than an invariant TSC as reads are uncached MMIO, but always stable
+	.rating = 250,
+	.read = &read_counter,
+};
+
+using namespace kernel;
+
+bool kernel::hpet::is_present() {
+	return hpet_base != nullptr;
+}
+
+time::ClockSource* kernel::hpet::clock_source() {
+	return is_present() ? &hpet_source : nullptr;
+}
+
+void kernel::hpet::init() {
+	const auto* table = reinterpret_cast<const HPETTable*>(acpi::find_table("HPET"));
+	if (!table) {
+		kdbgln("[HPET] no HPET table found");
+		return;
+	}
+	// 0 is system memory, anything else (I/O space) isn't something we can use
+	if (table->address_space_id != 0) {
+		kdbgln("[HPET] not memory mapped, ignoring");
+		return;
+	}
+
+	hpet_base = reinterpret_cast<volatile u64*>(PhysicalAddress(table->address).to_virtual().ptr());
+
+	const auto caps = read_reg(REG_CAPABILITIES);
+	const auto period_fs = caps >> 32;
+	timer_count = (caps >> 8 & 0b11111) + 1;
+	if (period_fs == 0 || period_fs > 100'000'000) {
+		// the spec says the period is at most 100ns
+		kdbgln("[HPET] invalid counter period ({} fs), ignoring", period_fs);
+		hpet_base = nullptr;
+		return;
+	}
+
+	if (!(caps & CAP_COUNTER_64BIT)) {
+		hpet_source.mask = 0xFFFFFFFF;
+		hpet_source.read = &read_counter_32;
+	}
+	hpet_source.set_frequency(FEMTOSECONDS_PER_SEC / period_fs);
+
+	// stop all comparators from firing before enabling the counter
+	for (u32 i = 0; i < timer_count; ++i) {
+		write_reg(timer_config_reg(i), read_reg(timer_config_reg(i)) & ~TIMER_INT_ENABLE);
+	}
+
+	// enable the main counter, in non legacy replacement mode
+	write_reg(REG_CONFIG, CONFIG_ENABLE);
+
+	time::register_clock_source(&hpet_source);
+
+	kdbgln("HPET initialized ({} Hz, {} comparators, {}-bit counter)",
+		hpet_source.frequency_hz, timer_count, hpet_source.mask == 0xFFFFFFFF ? 32 : 64);
+}
+
+static void set_comparator_enabled(bool enabled) {
+	static bool is_enabled = false;
+	if (enabled == is_enabled) return;
+
+	const auto config = read_reg(timer_config_reg(event_timer));
+	write_reg(timer_config_reg(event_timer), enabled ? config | TIMER_INT_ENABLE : config & ~TIMER_INT_ENABLE);
+	is_enabled = enabled;
+}
+
+static void set_next_event(u64 delta_ns) {
+	const auto mask = comparator_mask;
+	auto ticks = hpet_source.ns_to_cycles(delta_ns);
+	if (ticks < 1) ticks = 1;
+
+	set_comparator_enabled(true);
+
+	while (true) {
+		const auto target = (hpet_source.read() + ticks) & mask;
+		write_reg(timer_comparator_reg(event_timer), target);
+		// the comparator only fires when the counter matches it, so if the counter
+		// already went past it we'd wait for the whole counter to wrap around
+		const auto remaining = (target - hpet_source.read()) & mask;
+		if (remaining != 0 && remaining <= mask / 2) break;
+		ticks *= 2;
+	}
+}
+
+static void stop() {
+	set_comparator_enabled(false);
+}
+
+static time::ClockEventDevice hpet_device = {
+	.name = "hpet",
+	// the local APIC timer doesn't need MMIO to be reprogrammed, so prefer that
+	.rating = 50,
+	.set_next_event = &set_next_event,
+	.stop = &stop,
+};
+
+static void handle_interrupt() {
+	apic::send_eoi();
+	time::handle_clock_event();
+}
+
+void kernel::hpet::init_clock_event() {
+	if (!is_present()) return;
+
+	// find a comparator that can be routed to an I/O APIC input.
+	// the first two are usually only routable through legacy replacement mode
+	u32 gsi = 0;
+	bool found = false;
+	for (u32 i = 0; i < timer_count && !found; ++i) {
+		const auto config = read_reg(timer_config_reg(i));
+		const auto route_cap = static_cast<u32>(config >> 32);
+		// prefer GSIs that aren't shared with ISA devices
+		for (u32 bit = 16; bit < 32; ++bit) {
+			if (route_cap & (1u << bit)) {
+				event_timer = i;
+				gsi = bit;
+				found = true;
+				break;
+			}
+		}
+	}
+	if (!found) {
+		kdbgln("[HPET] no comparator can be routed to the I/O APIC");
+		return;
+	}
+
+	const auto vector = idt::allocate_vector();
+	idt::set_irq_handler(vector, &handle_interrupt);
+	if (!apic::route_gsi(gsi, vector, false, false, false)) {
+		kdbgln("[HPET] GSI {} is not handled by any I/O APIC", gsi);
+		return;
+	}
+
+	// one-shot, edge triggered, routed to the gsi
+	auto config = read_reg(timer_config_reg(event_timer));
+	config &= ~(TIMER_LEVEL_TRIGGERED | TIMER_PERIODIC | TIMER_FSB_ENABLE | TIMER_32BIT_MODE | (u64(0b11111) << TIMER_ROUTE_SHIFT));
+	config |= u64(gsi) << TIMER_ROUTE_SHIFT;
+	write_reg(timer_config_reg(event_timer), config);
+
+	comparator_mask = config & TIMER_64BIT_CAPABLE ? hpet_source.mask : 0xFFFFFFFF;
+
+	hpet_device.min_delta_ns = mat::math::div_ceil<u64>(time::NS_PER_SEC, hpet_source.frequency_hz) * 16;
+	// keep deltas within half the comparator range so the wrap check above works
+	hpet_device.max_delta_ns = hpet_source.cycles_to_ns(comparator_mask / 2);
+	if (hpet_device.max_delta_ns > time::NS_PER_SEC * 60) {
+		hpet_device.max_delta_ns = time::NS_PER_SEC * 60;
+	}
+
+	time::register_clock_event(&hpet_device);
+
+	kdbgln("HPET comparator {} routed to GSI {}", event_timer, gsi);
+}
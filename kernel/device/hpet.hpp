@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stl/types.hpp>
+#include <kernel/time/clocksource.hpp>
+
+namespace kernel::hpet {
+
+// Finds the HPET through its ACPI table, starts the main counter and
+// registers it as a clock source. Does nothing if there is no HPET.
+void init();
+
+// Sets up a comparator as a clock event device.
+// Has to be called after `time::init`.
+void init_clock_event();
+
+bool is_present();
+
+// The main counter as a clock source, or nullptr if there is no HPET.
+time::ClockSource* clock_source();
+
+}
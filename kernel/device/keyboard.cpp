@@ -1,149 +1,104 @@
-#include <stl/string.hpp>
+#include <stl/ring.hpp>
+#include <kernel/device/keyboard.hpp>
+#include <kernel/device/scancode.hpp>
 #include <kernel/device/ps2.hpp>
-#include <kernel/device/pic.hpp>
+#include <kernel/device/apic.hpp>
+#include <kernel/idt.hpp>
+#include <kernel/input/input.hpp>
+#include <kernel/async/executor.hpp>
+#include <kernel/async/event.hpp>
+#include <kernel/sync/wait_queue.hpp>
+#include <kernel/time/time.hpp>
 #include <kernel/log.hpp>
 #include <kernel/intrinsics.hpp>
-#include <kernel/screen/terminal.hpp>
-
-enum class KeyKind {
-	Other,
-	Printable,
-
-	Escape,
-	Enter,
-	Backspace,
-	CapsLock,
-	Left,
-	Right,
-	Up,
-	Down,
-	
-	LeftCtrl,
-	RightCtrl,
-	LeftShift,
-	RightShift,
-	LeftAlt,
-	RightAlt
-};
 
-struct Modifiers {
-	bool ctrl = false;
-	bool shift = false;
-	bool alt = false;
-	bool caps = false;
-} modifiers;
+using namespace kernel;
+using namespace kernel::keyboard;
+
+// the controller translates whatever the keyboard sends to set 1, unless told not to
+static constexpr auto SCANCODE_SET = ScancodeSet::Set1;
 
-struct Key {
-	KeyKind kind = KeyKind::Other;
-	char ch = 0;
+// A scancode as the interrupt handler read it.
+struct RawScancode {
+	u8 byte = 0;
+	u64 timestamp = 0;
 };
 
-Key key_map[256];
-
-char apply_shift(Key key) {
-	switch (key.ch) {
-		case '1': return '!';
-		case '2': return '@';
-		case '3': return '#';
-		case '4': return '$';
-		case '5': return '%';
-		case '6': return '^';
-		case '7': return '&';
-		case '8': return '*';
-		case '9': return '(';
-		case '0': return ')';
-		case ',': return '<';
-		case '.': return '>';
-		case '/': return '?';
-		case ';': return ':';
-		case '\'': return '"';
-		case '[': return '{';
-		case ']': return '}';
-		case '-': return '_';
-		case '=': return '+';
-		default: return key.ch;
-	}
-}
+// filled by the interrupt handler, drained by the decoder
+static constexpr usize SCANCODE_QUEUE_SIZE = 64;
+constinit static mat::SPSCRing<RawScancode, SCANCODE_QUEUE_SIZE> scancode_queue;
+static async::IrqEvent scancode_event;
 
-u64 long_scan_code = 0;
+// filled by the decoder, drained by whoever reads key events
+static constexpr usize EVENT_QUEUE_SIZE = 128;
+constinit static mat::SPSCRing<KeyEvent, EVENT_QUEUE_SIZE> event_queue;
+static sync::WaitQueue event_waiters;
 
-void kernel::ps2::handle_keyboard() {
-	const auto byte = inb(PS2_DATA_PORT);
-	if (byte == 0xe0) {
-		long_scan_code = byte;
-	} else {
-		const bool pressed = !(byte & 0x80);
-		const auto code = byte & ~0x80;
-
-		const auto key = key_map[code];
-		
-		if (key.kind == KeyKind::Printable) {
-			if (pressed) {
-				char ch = key.ch;
-				if (mat::is_ascii_alpha(key.ch)) {
-					// the character is uppercase by default
-					ch = modifiers.shift != modifiers.caps ? key.ch : mat::to_ascii_lowercase(key.ch);
-				} else if (modifiers.shift) {
-					ch = apply_shift(key);
-				}
-				kernel::terminal::type_character(ch);
-			}
-		} else if (key.kind == KeyKind::Enter || key.kind == KeyKind::Backspace) {
-			if (pressed) {
-				kernel::terminal::type_character(key.ch);
-			}
-		} else if (key.kind == KeyKind::LeftCtrl || key.kind == KeyKind::RightCtrl) {
-			modifiers.ctrl = pressed;
-		} else if (key.kind == KeyKind::LeftShift || key.kind == KeyKind::RightShift) {
-			modifiers.shift = pressed;
-		} else if (key.kind == KeyKind::LeftAlt || key.kind == KeyKind::RightAlt) {
-			modifiers.alt = pressed;
-		} else if (key.kind == KeyKind::CapsLock) {
-			if (pressed) {
-				modifiers.caps = !modifiers.caps;
+static u64 dropped_scancodes = 0;
+static u64 dropped_events = 0;
+
+// Runs on the executor for as long as the kernel does, decoding scancodes as they come in.
+static async::Task<> decode_scancodes() {
+	Decoder<SCANCODE_SET> decoder;
+	while (true) {
+		co_await scancode_event.wait();
+
+		// the event doesn't count signals, so take everything that's there
+		RawScancode scancodes[SCANCODE_QUEUE_SIZE];
+		const auto count = scancode_queue.pop_batch(scancodes, SCANCODE_QUEUE_SIZE);
+		bool decoded = false;
+		for (usize i = 0; i < count; ++i) {
+			KeyEvent event;
+			if (!decoder.feed(scancodes[i].byte, event)) continue;
+			event.timestamp = scancodes[i].timestamp;
+			if (event_queue.push(event)) {
+				decoded = true;
+			} else {
+				__atomic_fetch_add(&dropped_events, 1, __ATOMIC_RELAXED);
 			}
-		} else {
-			kdbg("({:02x})", byte);
+		}
+		if (decoded) {
+			event_waiters.wake_all();
+			input::notify();
 		}
 	}
-	
-	pic::send_eoi(1);
 }
 
-void kernel::ps2::init_keyboard() {
-	// enable PS/2 keyboard
-	pic::set_irq_mask(1, true);
+usize kernel::keyboard::poll(KeyEvent* events, usize max) {
+	return event_queue.pop_batch(events, max);
+}
 
-	// mfw no enumeration in c++
-	usize i = 0x10;
-	for (char c : "QWERTYUIOP") {
-		if (c == 0) break;
-		key_map[i++] = Key { KeyKind::Printable, c };
-	}
-	i = 0x1e;
-	for (char c : "ASDFGHJKL;'") {
-		if (c == 0) break;
-		key_map[i++] = Key { KeyKind::Printable, c };
+usize kernel::keyboard::read(KeyEvent* events, usize max) {
+	while (true) {
+		if (const auto count = poll(events, max)) return count;
+		event_waiters.wait_until([] { return !event_queue.is_empty(); });
 	}
-	i = 0x2c;
-	for (char c : "ZXCVBNM,./") {
-		if (c == 0) break;
-		key_map[i++] = Key { KeyKind::Printable, c };
-	}
-	i = 0x02;
-	for (char c : "1234567890-=") {
-		if (c == 0) break;
-		key_map[i++] = Key { KeyKind::Printable, c };
+}
+
+void kernel::keyboard::dump_stats() {
+	kdbgln("[keyboard] dropped {} scancodes, {} events", __atomic_load_n(&dropped_scancodes, __ATOMIC_RELAXED),
+		__atomic_load_n(&dropped_events, __ATOMIC_RELAXED));
+}
+
+void kernel::ps2::handle_keyboard() {
+	// reading the byte is what acknowledges the keyboard, decoding
+	// it and reacting to it is left for later
+	const RawScancode scancode { .byte = inb(PS2_DATA_PORT), .timestamp = time::cycles() };
+	apic::send_eoi();
+
+	// this is the only producer, so no lock is needed even with the decoder on another CPU
+	if (!scancode_queue.push(scancode)) {
+		__atomic_fetch_add(&dropped_scancodes, 1, __ATOMIC_RELAXED);
 	}
-	key_map[0x39] = Key { KeyKind::Printable, ' ' };
-	
-	key_map[0x01] = Key { KeyKind::Escape };
-	key_map[0x1c] = Key { KeyKind::Enter, '\n' };
-	key_map[0x0e] = Key { KeyKind::Backspace, '\x08' };
-
-	key_map[0x1d] = Key { KeyKind::LeftCtrl };
-	key_map[0x2a] = Key { KeyKind::LeftShift };
-	key_map[0x36] = Key { KeyKind::RightShift };
-	key_map[0x38] = Key { KeyKind::LeftAlt };
-	key_map[0x3a] = Key { KeyKind::CapsLock };
-}
\ No newline at end of file
+
+	scancode_event.signal();
+}
+
+void kernel::ps2::init_keyboard() {
+	// it only starts running once the executor does
+	async::spawn(decode_scancodes());
+
+	// enable PS/2 keyboard
+	idt::set_irq_handler(IRQ_VECTOR_BASE + 1, &handle_keyboard);
+	apic::set_irq_mask(1, true);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stl/types.hpp>
+
+namespace kernel::keyboard {
+
+enum class KeyKind : u8 {
+	Other,
+	// types a character, including the keypad ones
+	Printable,
+	// part of a longer sequence, not a key of its own (like the fake shifts around print screen)
+	Ignored,
+
+	Escape,
+	Enter,
+	Backspace,
+	Tab,
+	CapsLock,
+	NumLock,
+	ScrollLock,
+	Left,
+	Right,
+	Up,
+	Down,
+	Insert,
+	Delete,
+	Home,
+	End,
+	PageUp,
+	PageDown,
+	PrintScreen,
+	Pause,
+	F1,
+	F2,
+	F3,
+	F4,
+	F5,
+	F6,
+	F7,
+	F8,
+	F9,
+	F10,
+	F11,
+	F12,
+
+	LeftCtrl,
+	RightCtrl,
+	LeftShift,
+	RightShift,
+	LeftAlt,
+	RightAlt,
+	LeftGui,
+	RightGui,
+	Menu,
+};
+
+struct Modifiers {
+	bool ctrl = false;
+	bool shift = false;
+	bool alt = false;
+	bool caps = false;
+};
+
+// A decoded key press or release.
+struct KeyEvent {
+	KeyKind kind = KeyKind::Other;
+	// the character it types, with shift and caps lock applied. 0 if it doesn't type one
+	char ch = 0;
+	// as they were after this event
+	Modifiers modifiers;
+	bool pressed = false;
+	// the scancode, without the prefixes or the release bit
+	u8 code = 0;
+	// whether it came after a 0xe0 prefix
+	bool extended = false;
+	// TSC value from when the interrupt came in, compare against `time::cycles`
+	u64 timestamp = 0;
+};
+
+// Takes up to `max` queued key events without blocking, returning how many there were.
+// Only one reader at a time, the queue is single consumer. Once `input::init`
+// has run that is the input router, everything else should go through it.
+usize poll(KeyEvent* events, usize max);
+
+// Like `poll`, but blocks until there's at least one event. Threads only.
+usize read(KeyEvent* events, usize max);
+
+// Prints how many scancodes and events got dropped from full queues over serial.
+void dump_stats();
+
+}
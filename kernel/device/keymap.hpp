@@ -0,0 +1,139 @@
+#pragma once
+
+#include <stl/types.hpp>
+#include <kernel/device/keyboard.hpp>
+
+namespace kernel::keyboard {
+
+// What a key does, independent of how the keyboard reports it.
+struct Key {
+	KeyKind kind = KeyKind::Other;
+	char ch = 0;
+	// with shift held, or caps lock on for letters
+	char shifted = 0;
+};
+
+// One physical key, with its codes in both scancode sets.
+struct KeyDefinition {
+	u8 set1;
+	u8 set2;
+	// sent after a 0xe0 prefix
+	bool extended;
+	Key key;
+};
+
+// The US QWERTY layout. A different layout is just another one of these, passed to the
+// decoding tables in scancode.hpp instead.
+static constexpr KeyDefinition US_QWERTY[] = {
+	{ 0x01, 0x76, false, { KeyKind::Escape } },
+	{ 0x02, 0x16, false, { KeyKind::Printable, '1', '!' } },
+	{ 0x03, 0x1e, false, { KeyKind::Printable, '2', '@' } },
+	{ 0x04, 0x26, false, { KeyKind::Printable, '3', '#' } },
+	{ 0x05, 0x25, false, { KeyKind::Printable, '4', '$' } },
+	{ 0x06, 0x2e, false, { KeyKind::Printable, '5', '%' } },
+	{ 0x07, 0x36, false, { KeyKind::Printable, '6', '^' } },
+	{ 0x08, 0x3d, false, { KeyKind::Printable, '7', '&' } },
+	{ 0x09, 0x3e, false, { KeyKind::Printable, '8', '*' } },
+	{ 0x0a, 0x46, false, { KeyKind::Printable, '9', '(' } },
+	{ 0x0b, 0x45, false, { KeyKind::Printable, '0', ')' } },
+	{ 0x0c, 0x4e, false, { KeyKind::Printable, '-', '_' } },
+	{ 0x0d, 0x55, false, { KeyKind::Printable, '=', '+' } },
+	{ 0x0e, 0x66, false, { KeyKind::Backspace, '\x08', '\x08' } },
+	{ 0x0f, 0x0d, false, { KeyKind::Tab } },
+	{ 0x10, 0x15, false, { KeyKind::Printable, 'q', 'Q' } },
+	{ 0x11, 0x1d, false, { KeyKind::Printable, 'w', 'W' } },
+	{ 0x12, 0x24, false, { KeyKind::Printable, 'e', 'E' } },
+	{ 0x13, 0x2d, false, { KeyKind::Printable, 'r', 'R' } },
+	{ 0x14, 0x2c, false, { KeyKind::Printable, 't', 'T' } },
+	{ 0x15, 0x35, false, { KeyKind::Printable, 'y', 'Y' } },
+	{ 0x16, 0x3c, false, { KeyKind::Printable, 'u', 'U' } },
+	{ 0x17, 0x43, false, { KeyKind::Printable, 'i', 'I' } },
+	{ 0x18, 0x44, false, { KeyKind::Printable, 'o', 'O' } },
+	{ 0x19, 0x4d, false, { KeyKind::Printable, 'p', 'P' } },
+	{ 0x1a, 0x54, false, { KeyKind::Printable, '[', '{' } },
+	{ 0x1b, 0x5b, false, { KeyKind::Printable, ']', '}' } },
+	{ 0x1c, 0x5a, false, { KeyKind::Enter, '\n', '\n' } },
+	{ 0x1d, 0x14, false, { KeyKind::LeftCtrl } },
+	{ 0x1e, 0x1c, false, { KeyKind::Printable, 'a', 'A' } },
+	{ 0x1f, 0x1b, false, { KeyKind::Printable, 's', 'S' } },
+	{ 0x20, 0x23, false, { KeyKind::Printable, 'd', 'D' } },
+	{ 0x21, 0x2b, false, { KeyKind::Printable, 'f', 'F' } },
+	{ 0x22, 0x34, false, { KeyKind::Printable, 'g', 'G' } },
+	{ 0x23, 0x33, false, { KeyKind::Printable, 'h', 'H' } },
+	{ 0x24, 0x3b, false, { KeyKind::Printable, 'j', 'J' } },
+	{ 0x25, 0x42, false, { KeyKind::Printable, 'k', 'K' } },
+	{ 0x26, 0x4b, false, { KeyKind::Printable, 'l', 'L' } },
+	{ 0x27, 0x4c, false, { KeyKind::Printable, ';', ':' } },
+	{ 0x28, 0x52, false, { KeyKind::Printable, '\'', '"' } },
+	{ 0x29, 0x0e, false, { KeyKind::Printable, '`', '~' } },
+	{ 0x2a, 0x12, false, { KeyKind::LeftShift } },
+	{ 0x2b, 0x5d, false, { KeyKind::Printable, '\\', '|' } },
+	{ 0x2c, 0x1a, false, { KeyKind::Printable, 'z', 'Z' } },
+	{ 0x2d, 0x22, false, { KeyKind::Printable, 'x', 'X' } },
+	{ 0x2e, 0x21, false, { KeyKind::Printable, 'c', 'C' } },
+	{ 0x2f, 0x2a, false, { KeyKind::Printable, 'v', 'V' } },
+	{ 0x30, 0x32, false, { KeyKind::Printable, 'b', 'B' } },
+	{ 0x31, 0x31, false, { KeyKind::Printable, 'n', 'N' } },
+	{ 0x32, 0x3a, false, { KeyKind::Printable, 'm', 'M' } },
+	{ 0x33, 0x41, false, { KeyKind::Printable, ',', '<' } },
+	{ 0x34, 0x49, false, { KeyKind::Printable, '.', '>' } },
+	{ 0x35, 0x4a, false, { KeyKind::Printable, '/', '?' } },
+	{ 0x36, 0x59, false, { KeyKind::RightShift } },
+	{ 0x37, 0x7c, false, { KeyKind::Printable, '*', '*' } },
+	{ 0x38, 0x11, false, { KeyKind::LeftAlt } },
+	{ 0x39, 0x29, false, { KeyKind::Printable, ' ', ' ' } },
+	{ 0x3a, 0x58, false, { KeyKind::CapsLock } },
+	{ 0x3b, 0x05, false, { KeyKind::F1 } },
+	{ 0x3c, 0x06, false, { KeyKind::F2 } },
+	{ 0x3d, 0x04, false, { KeyKind::F3 } },
+	{ 0x3e, 0x0c, false, { KeyKind::F4 } },
+	{ 0x3f, 0x03, false, { KeyKind::F5 } },
+	{ 0x40, 0x0b, false, { KeyKind::F6 } },
+	{ 0x41, 0x83, false, { KeyKind::F7 } },
+	{ 0x42, 0x0a, false, { KeyKind::F8 } },
+	{ 0x43, 0x01, false, { KeyKind::F9 } },
+	{ 0x44, 0x09, false, { KeyKind::F10 } },
+	{ 0x45, 0x77, false, { KeyKind::NumLock } },
+	{ 0x46, 0x7e, false, { KeyKind::ScrollLock } },
+	// the keypad, as if num lock was always on
+	{ 0x47, 0x6c, false, { KeyKind::Printable, '7', '7' } },
+	{ 0x48, 0x75, false, { KeyKind::Printable, '8', '8' } },
+	{ 0x49, 0x7d, false, { KeyKind::Printable, '9', '9' } },
+	{ 0x4a, 0x7b, false, { KeyKind::Printable, '-', '-' } },
+	{ 0x4b, 0x6b, false, { KeyKind::Printable, '4', '4' } },
+	{ 0x4c, 0x73, false, { KeyKind::Printable, '5', '5' } },
+	{ 0x4d, 0x74, false, { KeyKind::Printable, '6', '6' } },
+	{ 0x4e, 0x79, false, { KeyKind::Printable, '+', '+' } },
+	{ 0x4f, 0x69, false, { KeyKind::Printable, '1', '1' } },
+	{ 0x50, 0x72, false, { KeyKind::Printable, '2', '2' } },
+	{ 0x51, 0x7a, false, { KeyKind::Printable, '3', '3' } },
+	{ 0x52, 0x70, false, { KeyKind::Printable, '0', '0' } },
+	{ 0x53, 0x71, false, { KeyKind::Printable, '.', '.' } },
+	{ 0x57, 0x78, false, { KeyKind::F11 } },
+	{ 0x58, 0x07, false, { KeyKind::F12 } },
+
+	{ 0x1c, 0x5a, true, { KeyKind::Enter, '\n', '\n' } },
+	{ 0x1d, 0x14, true, { KeyKind::RightCtrl } },
+	// print screen comes wrapped in a fake left shift press and release
+	{ 0x2a, 0x12, true, { KeyKind::Ignored } },
+	{ 0x35, 0x4a, true, { KeyKind::Printable, '/', '/' } },
+	// and with shift held, in a fake right shift
+	{ 0x36, 0x59, true, { KeyKind::Ignored } },
+	{ 0x37, 0x7c, true, { KeyKind::PrintScreen } },
+	{ 0x38, 0x11, true, { KeyKind::RightAlt } },
+	{ 0x47, 0x6c, true, { KeyKind::Home } },
+	{ 0x48, 0x75, true, { KeyKind::Up } },
+	{ 0x49, 0x7d, true, { KeyKind::PageUp } },
+	{ 0x4b, 0x6b, true, { KeyKind::Left } },
+	{ 0x4d, 0x74, true, { KeyKind::Right } },
+	{ 0x4f, 0x69, true, { KeyKind::End } },
+	{ 0x50, 0x72, true, { KeyKind::Down } },
+	{ 0x51, 0x7a, true, { KeyKind::PageDown } },
+	{ 0x52, 0x70, true, { KeyKind::Insert } },
+	{ 0x53, 0x71, true, { KeyKind::Delete } },
+	{ 0x5b, 0x1f, true, { KeyKind::LeftGui } },
+	{ 0x5c, 0x27, true, { KeyKind::RightGui } },
+	{ 0x5d, 0x2f, true, { KeyKind::Menu } },
+};
+
+}
@@ -0,0 +1,117 @@
+#include <kernel/device/lapic_timer.hpp>
+#include <kernel/device/apic.hpp>
+#include <kernel/device/pit.hpp>
+#include <kernel/time/clock_event.hpp>
+#include <kernel/time/time.hpp>
+#include <kernel/time/tsc.hpp>
+#include <kernel/idt.hpp>
+#include <kernel/log.hpp>
+#include <kernel/features.hpp>
+#include <kernel/intrinsics.hpp>
+
+static constexpr u32 IA32_TSC_DEADLINE_MSR = 0x6E0;
+
+static constexpr u32 LVT_TIMER_ONESHOT = 0b00 << 17;
+static constexpr u32 LVT_TIMER_TSC_DEADLINE = 0b10 << 17;
+
+// divide configuration for dividing the bus clock by 16
+static constexpr u32 TIMER_DIVIDE_16 = 0b0011;
+
+static constexpr u32 CALIBRATION_MS = 10;
+
+// local APIC timer ticks per millisecond, after the divider
+static u64 ticks_per_ms = 0;
+static bool tsc_deadline_mode = false;
+
+using namespace kernel;
+
+static void set_next_event_oneshot(u64 delta_ns) {
+	auto ticks = delta_ns * ticks_per_ms / time::NS_PER_MS;
+	if (ticks == 0) ticks = 1;
+	apic::lapic_write(apic::LAPIC_REG_TIMER_INITIAL, ticks);
+}
+
+static void stop_oneshot() {
+	// writing 0 to the initial count stops the timer
+	apic::lapic_write(apic::LAPIC_REG_TIMER_INITIAL, 0);
+}
+
+static void set_next_event_deadline(u64 delta_ns) {
+	wrmsr(IA32_TSC_DEADLINE_MSR, rdtsc() + tsc::ns_to_cycles(delta_ns));
+}
+
+static void stop_deadline() {
+	wrmsr(IA32_TSC_DEADLINE_MSR, 0);
+}
+
+static time::ClockEventDevice device = {
+	.name = "lapic-timer",
+	.rating = 100,
+	.per_cpu = true,
+};
+
+static void handle_interrupt() {
+	apic::send_eoi();
+	time::handle_clock_event();
+}
+
+static void calibrate() {
+	static constexpr u16 pit_ticks = pit::PIT_CLOCK_HZ / 1000 * CALIBRATION_MS;
+
+	apic::lapic_write(apic::LAPIC_REG_TIMER_DIVIDE, TIMER_DIVIDE_16);
+	apic::lapic_write(apic::LAPIC_REG_LVT_TIMER, apic::LAPIC_LVT_MASKED | LVT_TIMER_ONESHOT);
+
+	const auto flags = irq_save();
+	apic::lapic_write(apic::LAPIC_REG_TIMER_INITIAL, 0xFFFFFFFF);
+	pit::poll_wait(pit_ticks);
+	const auto remaining = apic::lapic_read(apic::LAPIC_REG_TIMER_CURRENT);
+	apic::lapic_write(apic::LAPIC_REG_TIMER_INITIAL, 0);
+	irq_restore(flags);
+
+	ticks_per_ms = (0xFFFFFFFF - remaining) / CALIBRATION_MS;
+}
+
+// sets up the timer of the calling CPU, in the mode picked by `init`
+static void setup_lvt() {
+	if (tsc_deadline_mode) {
+		apic::lapic_write(apic::LAPIC_REG_LVT_TIMER, LVT_TIMER_TSC_DEADLINE | LAPIC_TIMER_VECTOR);
+		// the LVT write has to be ordered before the first deadline write
+		asm volatile("mfence" : : : "memory");
+	} else {
+		apic::lapic_write(apic::LAPIC_REG_TIMER_DIVIDE, TIMER_DIVIDE_16);
+		apic::lapic_write(apic::LAPIC_REG_LVT_TIMER, LVT_TIMER_ONESHOT | LAPIC_TIMER_VECTOR);
+	}
+}
+
+void kernel::lapic_timer::init() {
+	idt::set_irq_handler(LAPIC_TIMER_VECTOR, &handle_interrupt);
+
+	tsc_deadline_mode = features::has(features::Feature::TSCDeadline);
+
+	if (tsc_deadline_mode) {
+		device.set_next_event = &set_next_event_deadline;
+		device.stop = &stop_deadline;
+		device.min_delta_ns = 1000;
+		device.max_delta_ns = time::NS_PER_SEC * 60;
+		// no bus clock conversion involved, so its slightly better
+		device.rating = 110;
+	} else {
+		// every CPU's bus clock runs at the same rate, so this only happens once
+		calibrate();
+
+		device.set_next_event = &set_next_event_oneshot;
+		device.stop = &stop_oneshot;
+		device.min_delta_ns = 1000;
+		// the initial count register is 32 bits
+		device.max_delta_ns = u64(0xFFFFFFFF) / ticks_per_ms * time::NS_PER_MS;
+	}
+
+	setup_lvt();
+	time::register_clock_event(&device);
+
+	kdbgln("Local APIC timer initialized ({} mode)", tsc_deadline_mode ? "TSC-deadline" : "one-shot");
+}
+
+void kernel::lapic_timer::init_local() {
+	setup_lvt();
+}
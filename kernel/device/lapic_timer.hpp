@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stl/types.hpp>
+
+namespace kernel::lapic_timer {
+
+// Calibrates the local APIC timer and registers it as the clock event device.
+// Uses TSC-deadline mode when the CPU supports it, one-shot mode otherwise.
+void init();
+
+// Sets up the local APIC timer of another CPU, after `init` ran on the bootstrap CPU.
+void init_local();
+
+}
@@ -0,0 +1,189 @@
+#include <stl/ring.hpp>
+#include <kernel/device/mouse.hpp>
+#include <kernel/device/ps2.hpp>
+#include <kernel/device/apic.hpp>
+#include <kernel/idt.hpp>
+#include <kernel/input/input.hpp>
+#include <kernel/sync/wait_queue.hpp>
+#include <kernel/time/time.hpp>
+#include <kernel/log.hpp>
+#include <kernel/intrinsics.hpp>
+
+using namespace kernel;
+using namespace kernel::mouse;
+
+static constexpr u8 COMMAND_ENABLE_AUX = 0xa8;
+static constexpr u8 COMMAND_READ_CONFIG = 0x20;
+static constexpr u8 COMMAND_WRITE_CONFIG = 0x60;
+// in the controller configuration byte
+static constexpr u8 CONFIG_AUX_IRQ = 1 << 1;
+static constexpr u8 CONFIG_AUX_CLOCK_DISABLED = 1 << 5;
+
+static constexpr u8 MOUSE_SET_DEFAULTS = 0xf6;
+static constexpr u8 MOUSE_SET_SAMPLE_RATE = 0xf3;
+static constexpr u8 MOUSE_GET_ID = 0xf2;
+static constexpr u8 MOUSE_ENABLE_REPORTING = 0xf4;
+// what a mouse with a scroll wheel answers to MOUSE_GET_ID, once it's been unlocked
+static constexpr u8 INTELLIMOUSE_ID = 3;
+static constexpr u8 SAMPLE_RATE = 100;
+
+// in the first byte of every packet
+static constexpr u8 PACKET_BUTTONS = 0b111;
+static constexpr u8 PACKET_ALWAYS_SET = 1 << 3;
+static constexpr u8 PACKET_X_SIGN = 1 << 4;
+static constexpr u8 PACKET_Y_SIGN = 1 << 5;
+static constexpr u8 PACKET_X_OVERFLOW = 1 << 6;
+static constexpr u8 PACKET_Y_OVERFLOW = 1 << 7;
+
+static bool found = false;
+// 4 with a scroll wheel
+static u8 packet_size = 3;
+
+// packet assembly, only touched by the interrupt handler
+static u8 packet[4];
+static u8 packet_length = 0;
+
+// one entry per packet, merged on the way out
+static constexpr usize PACKET_QUEUE_SIZE = 256;
+constinit static mat::SPSCRing<MouseEvent, PACKET_QUEUE_SIZE> packet_queue;
+static sync::WaitQueue waiters;
+
+// reader side, the event packets are being merged into. it carries over to the next `poll`
+// if that one ran out of room, and may still take more packets then
+static MouseEvent carried;
+static bool has_carried = false;
+
+static u64 packets_received = 0;
+static u64 packets_dropped = 0;
+static u64 resyncs = 0;
+static u64 events_read = 0;
+
+static bool set_sample_rate(u8 rate) {
+	return ps2::write_aux(MOUSE_SET_SAMPLE_RATE) && ps2::write_aux(rate);
+}
+
+static MouseEvent parse_packet(u64 timestamp) {
+	const auto flags = packet[0];
+	MouseEvent event;
+	// the deltas are 9 bit two's complement, with the sign bits in the first byte
+	if (!(flags & PACKET_X_OVERFLOW)) {
+		event.dx = i32(packet[1]) - (flags & PACKET_X_SIGN ? 0x100 : 0);
+	}
+	if (!(flags & PACKET_Y_OVERFLOW)) {
+		event.dy = i32(packet[2]) - (flags & PACKET_Y_SIGN ? 0x100 : 0);
+	}
+	if (packet_size == 4) {
+		// sign extend the low 4 bits, the rest are buttons 4 and 5 on 5 button mice
+		event.wheel = i8(u8(packet[3] << 4)) >> 4;
+	}
+	event.buttons = flags & PACKET_BUTTONS;
+	event.packets = 1;
+	event.timestamp = timestamp;
+	return event;
+}
+
+void kernel::ps2::handle_mouse() {
+	const auto byte = inb(PS2_DATA_PORT);
+	const auto timestamp = time::cycles();
+	apic::send_eoi();
+
+	// the first byte always has this bit set. if it isn't, a byte got lost
+	// somewhere, so skip ahead until something looks like the start of a packet
+	if (packet_length == 0 && !(byte & PACKET_ALWAYS_SET)) {
+		resyncs++;
+		return;
+	}
+	packet[packet_length++] = byte;
+	if (packet_length < packet_size) return;
+	packet_length = 0;
+
+	packets_received++;
+	if (!packet_queue.push(parse_packet(timestamp))) {
+		packets_dropped++;
+		return;
+	}
+	waiters.wake_all();
+	input::notify();
+}
+
+void kernel::ps2::init_mouse() {
+	u8 config;
+	if (!write_command(COMMAND_ENABLE_AUX) || !write_command(COMMAND_READ_CONFIG) || !read_data(config)) {
+		kdbgln("[mouse] controller didn't respond");
+		return;
+	}
+	config = (config | CONFIG_AUX_IRQ) & ~CONFIG_AUX_CLOCK_DISABLED;
+	if (!write_command(COMMAND_WRITE_CONFIG) || !write_data(config)) return;
+
+	if (!write_aux(MOUSE_SET_DEFAULTS)) {
+		kdbgln("[mouse] no mouse found");
+		return;
+	}
+
+	// this sequence of sample rates is how the wheel gets unlocked on IntelliMouse compatible mice
+	u8 id = 0;
+	if (set_sample_rate(200) && set_sample_rate(100) && set_sample_rate(80) && write_aux(MOUSE_GET_ID)) {
+		read_data(id);
+	}
+	packet_size = id == INTELLIMOUSE_ID ? 4 : 3;
+	set_sample_rate(SAMPLE_RATE);
+
+	if (!write_aux(MOUSE_ENABLE_REPORTING)) {
+		kdbgln("[mouse] failed to enable reporting");
+		return;
+	}
+
+	found = true;
+	idt::set_irq_handler(IRQ_VECTOR_BASE + 12, &handle_mouse);
+	apic::set_irq_mask(12, true);
+
+	kdbgln("[mouse] found, {}", packet_size == 4 ? "with a scroll wheel" : "without a scroll wheel");
+}
+
+bool kernel::mouse::present() {
+	return found;
+}
+
+usize kernel::mouse::poll(MouseEvent* events, usize max) {
+	usize count = 0;
+	MouseEvent packet;
+	while (count < max) {
+		if (!has_carried) {
+			if (!packet_queue.pop(carried)) break;
+			has_carried = true;
+			continue;
+		}
+		if (!packet_queue.pop(packet)) {
+			events[count++] = carried;
+			has_carried = false;
+			break;
+		}
+
+		// motion with the same buttons held just adds up, a button change has to stay its own event
+		if (packet.buttons == carried.buttons) {
+			carried.dx += packet.dx;
+			carried.dy += packet.dy;
+			carried.wheel += packet.wheel;
+			carried.packets++;
+			carried.timestamp = packet.timestamp;
+		} else {
+			events[count++] = carried;
+			carried = packet;
+		}
+	}
+
+	events_read += count;
+	return count;
+}
+
+usize kernel::mouse::read(MouseEvent* events, usize max) {
+	while (true) {
+		if (const auto count = poll(events, max)) return count;
+		waiters.wait_until([] { return !packet_queue.is_empty(); });
+	}
+}
+
+void kernel::mouse::dump_stats() {
+	kdbgln("[mouse] {} packets, {} dropped, {} resyncs, read as {} events",
+		packets_received, packets_dropped, resyncs, events_read);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stl/types.hpp>
+
+namespace kernel::mouse {
+
+static constexpr u8 BUTTON_LEFT = 1 << 0;
+static constexpr u8 BUTTON_RIGHT = 1 << 1;
+static constexpr u8 BUTTON_MIDDLE = 1 << 2;
+
+// Mouse movement and button state. When read, consecutive packets with the same buttons
+// get merged into one event with their deltas added up.
+struct MouseEvent {
+	// positive is right and up, like the mouse reports it
+	i32 dx = 0;
+	i32 dy = 0;
+	// positive is scrolling down, always 0 without an IntelliMouse compatible wheel
+	i32 wheel = 0;
+	// BUTTON_* bits held down
+	u8 buttons = 0;
+	// how many packets went into this event
+	u32 packets = 0;
+	// TSC value from when the latest of those packets came in, compare against `time::cycles`
+	u64 timestamp = 0;
+};
+
+// Whether a mouse was found on the second PS/2 port.
+bool present();
+
+// Takes up to `max` events without blocking, returning how many there were.
+// Only one reader at a time, the queue is single consumer. Once `input::init`
+// has run that is the input router, everything else should go through it.
+usize poll(MouseEvent* events, usize max);
+
+// Like `poll`, but blocks until there's at least one event. Threads only.
+usize read(MouseEvent* events, usize max);
+
+// Prints packet and queue stats over serial.
+void dump_stats();
+
+}
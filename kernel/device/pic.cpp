@@ -69,7 +69,14 @@ void kernel::pic::send_eoi(u8 irq) {
 	outb(kernel::PIC1_COM_PORT, 0x20);
 }
 
+void kernel::pic::disable() {
+	outb(PIC1_DATA_PORT, 0xFF);
+	outb(PIC2_DATA_PORT, 0xFF);
+}
+
 void kernel::pic::init() {
+	// even if the PIC ends up disabled, it has to be remapped so that
+	// any spurious IRQs it raises don't land on the exception vectors
 	remap_pic(PIC_IRQ_OFFSET, PIC_IRQ_OFFSET + 8);
 
 	kdbgln("PIC initialized");
@@ -23,6 +23,9 @@ void set_irq_mask(u8 irq_index, bool enabled);
 // Sends an End Of Interrupt signal, required at the end of IRQs.
 void send_eoi(u8 irq);
 
+// Masks every IRQ on both PICs, for when the APIC takes over.
+void disable();
+
 }
 
 }
\ No newline at end of file
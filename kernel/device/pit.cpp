@@ -1,36 +1,30 @@
 #include <kernel/device/pit.hpp>
-#include <kernel/device/pic.hpp>
 #include <kernel/log.hpp>
 #include <kernel/intrinsics.hpp>
 
-static constexpr u32 PIT_CLOCK_HZ = 1.193182 * 1'000'000;
-static constexpr u16 PIT_CHANNEL0_PORT = 0x40;
+static constexpr u16 PIT_CHANNEL2_PORT = 0x42;
 static constexpr u16 PIT_COMMAND_PORT = 0x43;
+// bit 0 is the channel 2 gate, bit 1 the speaker, bit 5 the channel 2 output
+static constexpr u16 PIT_GATE_PORT = 0x61;
 
-// frequency at which the interrupts will be triggered
-static constexpr u32 FREQ_HZ = 1000;
-static constexpr u32 CLOCK_DIVISOR = PIT_CLOCK_HZ / FREQ_HZ;
-static_assert(CLOCK_DIVISOR <= 65536, "Invalid divisor for the PIT");
+void kernel::pit::poll_wait(u16 ticks) {
+	// gate on, speaker off
+	outb(PIT_GATE_PORT, (inb(PIT_GATE_PORT) & ~0b10) | 0b1);
+	// channel 2, low then high byte, interrupt on terminal count mode, not bcd
+	outb(PIT_COMMAND_PORT, 0b10'11'000'0);
+	outb(PIT_CHANNEL2_PORT, ticks & 0xFF);
+	outb(PIT_CHANNEL2_PORT, ticks >> 8);
 
-u64 tick_counter = 0;
-
-void kernel::pit::handle_interrupt() {
-	++tick_counter;
-	pic::send_eoi(0);
-}
-
-void kernel::sleep(u32 ms) {
-	const auto start = tick_counter;
-	while (tick_counter - start < ms) {
-		asm volatile("nop");
+	// output goes high once the count reaches 0
+	while (!(inb(PIT_GATE_PORT) & 0x20)) {
+		cpu_relax();
 	}
 }
 
 void kernel::pit::init() {
-	// channel 0, low then high byte, square wave mode, not bcd
-	outb(PIT_COMMAND_PORT, 0b00'11'010'0);
-	outb(PIT_CHANNEL0_PORT, CLOCK_DIVISOR & 0xFF);
-	outb(PIT_CHANNEL0_PORT, CLOCK_DIVISOR >> 8);
+	// channel 0, low then high byte, interrupt on terminal count mode, not bcd.
+	// without a count being written it never starts, so IRQ 0 stays quiet
+	outb(PIT_COMMAND_PORT, 0b00'11'000'0);
 
-	pic::set_irq_mask(0, true);
-}
\ No newline at end of file
+	kdbgln("PIT initialized");
+}
@@ -2,17 +2,15 @@
 
 #include <stl/types.hpp>
 
-namespace kernel {
+namespace kernel::pit {
 
-namespace pit {
+static constexpr u32 PIT_CLOCK_HZ = 1.193182 * 1'000'000;
 
+// Stops channel 0, the PIT is no longer used as the system tick.
 void init();
 
-void handle_interrupt();
+// Busy waits for a number of PIT ticks using channel 2, without interrupts.
+// Only meant for calibrating other timers. 65535 ticks is about 55ms.
+void poll_wait(u16 ticks);
 
 }
-
-// Sleeps for a set number of milliseconds.
-void sleep(u32 ms);
-
-}
\ No newline at end of file
@@ -1,10 +1,59 @@
 #include <kernel/device/pic.hpp>
 #include <kernel/device/ps2.hpp>
+#include <kernel/time/time.hpp>
 #include <kernel/log.hpp>
 #include <kernel/intrinsics.hpp>
 
+using namespace kernel;
+
+static constexpr u8 STATUS_OUTPUT_FULL = 1 << 0;
+static constexpr u8 STATUS_INPUT_FULL = 1 << 1;
+
+// sends the next data byte to the second port instead of the first
+static constexpr u8 COMMAND_WRITE_AUX = 0xd4;
+static constexpr u8 DEVICE_ACK = 0xfa;
+
+// generous, devices can take a while to answer a reset or a command
+static constexpr u64 TIMEOUT_NS = 100 * time::NS_PER_MS;
+
+template <class Func>
+static bool wait_for(Func condition) {
+	const auto deadline = time::monotonic_ns() + TIMEOUT_NS;
+	while (!condition()) {
+		if (time::monotonic_ns() > deadline) return false;
+		cpu_relax();
+	}
+	return true;
+}
+
+bool kernel::ps2::write_command(u8 command) {
+	if (!wait_for([] { return !(inb(PS2_COM_PORT) & STATUS_INPUT_FULL); })) return false;
+	outb(PS2_COM_PORT, command);
+	return true;
+}
+
+bool kernel::ps2::write_data(u8 byte) {
+	if (!wait_for([] { return !(inb(PS2_COM_PORT) & STATUS_INPUT_FULL); })) return false;
+	outb(PS2_DATA_PORT, byte);
+	return true;
+}
+
+bool kernel::ps2::read_data(u8& byte) {
+	if (!wait_for([] { return inb(PS2_COM_PORT) & STATUS_OUTPUT_FULL; })) return false;
+	byte = inb(PS2_DATA_PORT);
+	return true;
+}
+
+bool kernel::ps2::write_aux(u8 byte) {
+	u8 response;
+	return write_command(COMMAND_WRITE_AUX) && write_data(byte) && read_data(response) && response == DEVICE_ACK;
+}
+
 void kernel::ps2::init() {
+	// the mouse gets set up by polling, which has to be done before the keyboard IRQ
+	// could come in and take the responses
+	init_mouse();
 	init_keyboard();
 
 	kdbgln("PS/2 devices initialized");
-}
\ No newline at end of file
+}
@@ -13,4 +13,18 @@ void init_keyboard();
 
 void handle_keyboard();
 
-}
\ No newline at end of file
+// Sets up the mouse on the second port, if there is one.
+void init_mouse();
+
+void handle_mouse();
+
+// Polled access to the controller, for setting things up before the IRQs are on.
+// They return false if the controller didn't get ready in time.
+bool write_command(u8 command);
+bool write_data(u8 byte);
+bool read_data(u8& byte);
+
+// Sends a byte to the device on the second port, returning whether it acknowledged it.
+bool write_aux(u8 byte);
+
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <stl/types.hpp>
+#include <kernel/device/keyboard.hpp>
+#include <kernel/device/keymap.hpp>
+
+namespace kernel::keyboard {
+
+enum class ScancodeSet : u8 {
+	// what the PS/2 controller translates to by default, releases have the top bit set
+	Set1,
+	// what keyboards actually send, releases are prefixed with 0xf0
+	Set2,
+};
+
+// bits of the modifier keys that are held down
+static constexpr u8 MODIFIER_LEFT_CTRL = 1 << 0;
+static constexpr u8 MODIFIER_RIGHT_CTRL = 1 << 1;
+static constexpr u8 MODIFIER_LEFT_SHIFT = 1 << 2;
+static constexpr u8 MODIFIER_RIGHT_SHIFT = 1 << 3;
+static constexpr u8 MODIFIER_LEFT_ALT = 1 << 4;
+static constexpr u8 MODIFIER_RIGHT_ALT = 1 << 5;
+
+// A key with everything decoding needs worked out ahead of time, so it doesn't
+// have to look at the kind.
+struct DecodeEntry {
+	KeyKind kind = KeyKind::Other;
+	char ch = 0;
+	char shifted = 0;
+	// caps lock works like shift for this key, only letters
+	bool caps_lock = false;
+	// held while this is pressed, if it's a modifier
+	u8 modifier = 0;
+	bool toggles_caps_lock = false;
+};
+
+// One entry for every code, on the normal page and the one after 0xe0.
+struct DecodeTable {
+	DecodeEntry pages[2][256];
+};
+
+constexpr u8 modifier_bit(KeyKind kind) {
+	switch (kind) {
+		case KeyKind::LeftCtrl: return MODIFIER_LEFT_CTRL;
+		case KeyKind::RightCtrl: return MODIFIER_RIGHT_CTRL;
+		case KeyKind::LeftShift: return MODIFIER_LEFT_SHIFT;
+		case KeyKind::RightShift: return MODIFIER_RIGHT_SHIFT;
+		case KeyKind::LeftAlt: return MODIFIER_LEFT_ALT;
+		case KeyKind::RightAlt: return MODIFIER_RIGHT_ALT;
+		default: return 0;
+	}
+}
+
+// not constexpr, so a layout that maps one code twice fails to compile
+void layout_has_duplicate_scancode();
+
+template <usize Size>
+constexpr DecodeTable make_decode_table(ScancodeSet set, const KeyDefinition (&layout)[Size]) {
+	DecodeTable table {};
+	for (const auto& definition : layout) {
+		const auto code = set == ScancodeSet::Set1 ? definition.set1 : definition.set2;
+		auto& entry = table.pages[definition.extended][code];
+		if (entry.kind != KeyKind::Other) {
+			layout_has_duplicate_scancode();
+		}
+
+		const auto& key = definition.key;
+		entry = DecodeEntry {
+			.kind = key.kind,
+			.ch = key.ch,
+			.shifted = key.shifted,
+			.caps_lock = key.ch >= 'a' && key.ch <= 'z',
+			.modifier = modifier_bit(key.kind),
+			.toggles_caps_lock = key.kind == KeyKind::CapsLock,
+		};
+	}
+	return table;
+}
+
+template <ScancodeSet Set>
+inline constexpr DecodeTable DECODE_TABLE = make_decode_table(Set, US_QWERTY);
+
+// Turns a stream of scancode bytes into key events. Prefix bytes only update the state,
+// everything else is a lookup in the decoding table.
+template <ScancodeSet Set>
+class Decoder {
+	// pause is the one key with a long sequence (and no release), its bytes are just counted
+	static constexpr u8 PAUSE_LENGTH = Set == ScancodeSet::Set1 ? 6 : 8;
+
+	bool m_extended = false;
+	bool m_release = false;
+	// bytes of a pause sequence still to come
+	u8 m_pause_left = 0;
+	u8 m_held = 0;
+	bool m_caps_lock = false;
+
+public:
+	// Feeds in the next byte, returning true and filling in `event` (apart from the timestamp)
+	// once it completes a key press or release.
+	constexpr bool feed(u8 byte, KeyEvent& event) {
+		if (m_pause_left) {
+			if (--m_pause_left) return false;
+			event = KeyEvent { .kind = KeyKind::Pause, .modifiers = modifiers(), .pressed = true };
+			return true;
+		}
+
+		if (byte == 0xe0) {
+			m_extended = true;
+			return false;
+		}
+		if (byte == 0xe1) {
+			m_pause_left = PAUSE_LENGTH - 1;
+			return false;
+		}
+		if (Set == ScancodeSet::Set2 && byte == 0xf0) {
+			m_release = true;
+			return false;
+		}
+
+		const bool release = Set == ScancodeSet::Set1 ? byte & 0x80 : m_release;
+		const u8 code = Set == ScancodeSet::Set1 ? byte & 0x7f : byte;
+		const bool extended = m_extended;
+		m_extended = false;
+		m_release = false;
+
+		const auto& entry = DECODE_TABLE<Set>.pages[extended][code];
+		if (entry.kind == KeyKind::Ignored) return false;
+
+		m_held = release ? m_held & ~entry.modifier : m_held | entry.modifier;
+		m_caps_lock ^= entry.toggles_caps_lock && !release;
+
+		const auto current = modifiers();
+		const bool shifted = current.shift != (current.caps && entry.caps_lock);
+		event = KeyEvent {
+			.kind = entry.kind,
+			.ch = shifted ? entry.shifted : entry.ch,
+			.modifiers = current,
+			.pressed = !release,
+			.code = code,
+			.extended = extended,
+		};
+		return true;
+	}
+
+	constexpr Modifiers modifiers() const {
+		return Modifiers {
+			.ctrl = (m_held & (MODIFIER_LEFT_CTRL | MODIFIER_RIGHT_CTRL)) != 0,
+			.shift = (m_held & (MODIFIER_LEFT_SHIFT | MODIFIER_RIGHT_SHIFT)) != 0,
+			.alt = (m_held & (MODIFIER_LEFT_ALT | MODIFIER_RIGHT_ALT)) != 0,
+			.caps = m_caps_lock,
+		};
+	}
+};
+
+namespace impl {
+
+struct Decoded {
+	KeyEvent last;
+	usize count = 0;
+};
+
+// Feeds in every byte, returning the last event and how many there were.
+template <ScancodeSet Set, usize Size>
+constexpr Decoded decode(const u8 (&bytes)[Size]) {
+	Decoder<Set> decoder;
+	Decoded decoded;
+	for (const auto byte : bytes) {
+		KeyEvent event;
+		if (decoder.feed(byte, event)) {
+			decoded.last = event;
+			decoded.count++;
+		}
+	}
+	return decoded;
+}
+
+}
+
+// only one of the sets gets used, so make sure both tables get built and decode right
+static_assert(impl::decode<ScancodeSet::Set1>({ 0x1e }).last.ch == 'a');
+static_assert(impl::decode<ScancodeSet::Set2>({ 0x1c }).last.ch == 'a');
+static_assert(!impl::decode<ScancodeSet::Set1>({ 0x9e }).last.pressed);
+static_assert(!impl::decode<ScancodeSet::Set2>({ 0xf0, 0x1c }).last.pressed);
+static_assert(impl::decode<ScancodeSet::Set1>({ 0x2a, 0x1e }).last.ch == 'A');
+static_assert(impl::decode<ScancodeSet::Set2>({ 0x12, 0x1c }).last.ch == 'A');
+
+static_assert(impl::decode<ScancodeSet::Set1>({ 0xe0, 0x48 }).last.kind == KeyKind::Up);
+static_assert(impl::decode<ScancodeSet::Set2>({ 0xe0, 0x75 }).last.kind == KeyKind::Up);
+static_assert(impl::decode<ScancodeSet::Set1>({ 0xe0, 0x2a }).count == 0);
+static_assert(impl::decode<ScancodeSet::Set2>({ 0xe0, 0x12 }).count == 0);
+
+// pause is a single press, and the key after it decodes normally
+static_assert(impl::decode<ScancodeSet::Set1>({ 0xe1, 0x1d, 0x45, 0xe1, 0x9d, 0xc5 }).last.kind == KeyKind::Pause);
+static_assert(impl::decode<ScancodeSet::Set2>({ 0xe1, 0x14, 0x77, 0xe1, 0xf0, 0x14, 0xf0, 0x77 }).last.kind == KeyKind::Pause);
+static_assert(impl::decode<ScancodeSet::Set1>({ 0xe1, 0x1d, 0x45, 0xe1, 0x9d, 0xc5, 0x1e }).count == 2);
+static_assert(impl::decode<ScancodeSet::Set2>({ 0xe1, 0x14, 0x77, 0xe1, 0xf0, 0x14, 0xf0, 0x77, 0x1c }).last.ch == 'a');
+
+}
@@ -0,0 +1,205 @@
+#include <kernel/dispatch.hpp>
+#include <kernel/features.hpp>
+#include <kernel/fpu.hpp>
+#include <kernel/simd/blit.hpp>
+#include <kernel/log.hpp>
+
+using namespace kernel;
+using features::Feature;
+
+// the memcpy and memset variants use rep string instructions directly,
+// since gcc may turn a plain loop back into a call to memcpy or memset
+
+static void* memcpy_movsq(void* dest, const void* src, usize count) {
+	auto* ptr = dest;
+	usize qwords = count / 8;
+	usize bytes = count % 8;
+	asm volatile("rep movsq" : "+D"(ptr), "+S"(src), "+c"(qwords) : : "memory");
+	asm volatile("rep movsb" : "+D"(ptr), "+S"(src), "+c"(bytes) : : "memory");
+	return dest;
+}
+
+// with ERMS the microcode copies in big chunks by itself, and FSRM makes it fast for short copies too
+static void* memcpy_movsb(void* dest, const void* src, usize count) {
+	auto* ptr = dest;
+	asm volatile("rep movsb" : "+D"(ptr), "+S"(src), "+c"(count) : : "memory");
+	return dest;
+}
+
+static void* memset_stosq(void* dest, int value, usize count) {
+	auto* ptr = dest;
+	usize qwords = count / 8;
+	usize bytes = count % 8;
+	const u64 pattern = u8(value) * 0x0101010101010101;
+	asm volatile("rep stosq" : "+D"(ptr), "+c"(qwords) : "a"(pattern) : "memory");
+	asm volatile("rep stosb" : "+D"(ptr), "+c"(bytes) : "a"(pattern) : "memory");
+	return dest;
+}
+
+static void* memset_stosb(void* dest, int value, usize count) {
+	auto* ptr = dest;
+	asm volatile("rep stosb" : "+D"(ptr), "+c"(count) : "a"(value) : "memory");
+	return dest;
+}
+
+// reflected Castagnoli polynomial
+static constexpr u32 CRC32C_POLYNOMIAL = 0x82f63b78;
+
+struct CRCTable {
+	u32 entries[256];
+};
+
+static constexpr CRCTable CRC32C_TABLE = [] {
+	CRCTable table {};
+	for (u32 i = 0; i < 256; ++i) {
+		u32 crc = i;
+		for (u32 bit = 0; bit < 8; ++bit) {
+			crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLYNOMIAL : crc >> 1;
+		}
+		table.entries[i] = crc;
+	}
+	return table;
+}();
+
+static u32 crc32c_table(u32 crc, const void* data, usize size) {
+	const auto* bytes = static_cast<const u8*>(data);
+	crc = ~crc;
+	for (usize i = 0; i < size; ++i) {
+		crc = CRC32C_TABLE.entries[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+// the crc32 instruction came with SSE4.2, but only works on general purpose registers,
+// so it doesn't need the SIMD state to be enabled
+static u32 crc32c_sse42(u32 crc, const void* data, usize size) {
+	const auto* bytes = static_cast<const u8*>(data);
+	u64 result = ~crc;
+	usize i = 0;
+	for (; i + sizeof(u64) <= size; i += sizeof(u64)) {
+		// unaligned loads are fine on x86, this just becomes a mov
+		u64 word;
+		__builtin_memcpy(&word, bytes + i, sizeof(word));
+		asm("crc32q %1, %0" : "+r"(result) : "rm"(word));
+	}
+	for (; i < size; ++i) {
+		asm("crc32b %1, %k0" : "+r"(result) : "rm"(bytes[i]));
+	}
+	return ~u32(result);
+}
+
+static void fill32_loop(u32* dest, u32 value, usize count) {
+	for (usize i = 0; i < count; ++i) {
+		dest[i] = value;
+	}
+}
+
+// fast strings make rep stos beat a store loop for long rows
+static void fill32_stosq(u32* dest, u32 value, usize count) {
+	usize qwords = count / 2;
+	const u64 pattern = value | u64(value) << 32;
+	asm volatile("rep stosq" : "+D"(dest), "+c"(qwords) : "a"(pattern) : "memory");
+	if (count % 2) {
+		*dest = value;
+	}
+}
+
+static void copy32_loop(u32* dest, const u32* src, usize count) {
+	for (usize i = 0; i < count; ++i) {
+		dest[i] = src[i];
+	}
+}
+
+static void copy32_movsb(u32* dest, const u32* src, usize count) {
+	memcpy_movsb(dest, src, count * sizeof(u32));
+}
+
+// making the SIMD registers usable costs a CR0 write or two, so short rows aren't worth it
+static constexpr usize SIMD_MIN_PIXELS = 256;
+
+static void fill32_sse2(u32* dest, u32 value, usize count) {
+	if (count < SIMD_MIN_PIXELS) return fill32_loop(dest, value, count);
+	fpu::Guard guard;
+	simd::fill32_sse2(dest, value, count);
+}
+
+static void copy32_sse2(u32* dest, const u32* src, usize count) {
+	if (count < SIMD_MIN_PIXELS) return copy32_loop(dest, src, count);
+	fpu::Guard guard;
+	simd::copy32_sse2(dest, src, count);
+}
+
+static void fill32_avx2(u32* dest, u32 value, usize count) {
+	if (count < SIMD_MIN_PIXELS) return fill32_stosq(dest, value, count);
+	fpu::Guard guard;
+	simd::fill32_avx2(dest, value, count);
+}
+
+static void copy32_avx2(u32* dest, const u32* src, usize count) {
+	if (count < SIMD_MIN_PIXELS) return copy32_movsb(dest, src, count);
+	fpu::Guard guard;
+	simd::copy32_avx2(dest, src, count);
+}
+
+static usize find_first_zero_bsf(const u64* bitmap, usize words) {
+	for (usize i = 0; i < words; ++i) {
+		if (~bitmap[i]) {
+			return i * 64 + __builtin_ctzll(~bitmap[i]);
+		}
+	}
+	return words * 64;
+}
+
+// tzcnt is quicker than bsf on AMD, and is what the builtin would be with -mbmi
+static usize find_first_zero_tzcnt(const u64* bitmap, usize words) {
+	for (usize i = 0; i < words; ++i) {
+		const u64 inverted = ~bitmap[i];
+		if (inverted) {
+			u64 index;
+			asm("tzcnt %1, %0" : "=r"(index) : "r"(inverted));
+			return i * 64 + index;
+		}
+	}
+	return words * 64;
+}
+
+// constant initialized, so this works before any constructors would have run
+constinit dispatch::Table dispatch::table = {
+	.memcpy = &memcpy_movsq,
+	.memset = &memset_stosq,
+	.crc32c = &crc32c_table,
+	.fill32 = &fill32_loop,
+	.copy32 = &copy32_loop,
+	.find_first_zero = &find_first_zero_bsf,
+};
+
+void kernel::dispatch::init() {
+	const bool fast_strings = features::has(Feature::ERMS) || features::has(Feature::FSRM);
+	const bool avx2 = fpu::avx_enabled() && features::has(Feature::AVX2);
+	if (fast_strings) {
+		table.memcpy = &memcpy_movsb;
+		table.memset = &memset_stosb;
+	}
+	// every x86-64 CPU has SSE2, it only loses to fast strings
+	if (avx2) {
+		table.fill32 = &fill32_avx2;
+		table.copy32 = &copy32_avx2;
+	} else if (fast_strings) {
+		table.fill32 = &fill32_stosq;
+		table.copy32 = &copy32_movsb;
+	} else {
+		table.fill32 = &fill32_sse2;
+		table.copy32 = &copy32_sse2;
+	}
+	if (features::has(Feature::SSE4_2)) {
+		table.crc32c = &crc32c_sse42;
+	}
+	if (features::has(Feature::BMI1)) {
+		table.find_first_zero = &find_first_zero_tzcnt;
+	}
+
+	kdbgln("[dispatch] memcpy/memset: {}, crc32c: {}, blitters: {}, bitmap scans: {}",
+		fast_strings ? "rep movsb" : "rep movsq", features::has(Feature::SSE4_2) ? "sse4.2" : "table",
+		avx2 ? "avx2" : fast_strings ? "rep string" : "sse2", features::has(Feature::BMI1) ? "tzcnt" : "bsf");
+	kdbgln("Dispatch initialized");
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stl/types.hpp>
+
+namespace kernel::dispatch {
+
+// Hot routines with more than one implementation, picked once for the CPU at boot.
+// Until `init` runs these point at baseline versions that work on any x86-64 CPU,
+// so they're safe to call from the very start.
+struct Table {
+	void* (*memcpy)(void* dest, const void* src, usize count);
+	void* (*memset)(void* dest, int value, usize count);
+	// CRC-32C (Castagnoli), continuing from `crc`. Start with 0.
+	u32 (*crc32c)(u32 crc, const void* data, usize size);
+	// blitters, for a single row of 32 bit pixels
+	void (*fill32)(u32* dest, u32 value, usize count);
+	void (*copy32)(u32* dest, const u32* src, usize count);
+	// index of the first clear bit in a bitmap of `words` u64s, or `words * 64` if there is none
+	usize (*find_first_zero)(const u64* bitmap, usize words);
+};
+
+extern Table table;
+
+// Picks the best implementation of everything in the table, based on the CPU features.
+// Must be called after `features::init` and `fpu::init`.
+void init();
+
+inline u32 crc32c(u32 crc, const void* data, usize size) {
+	return table.crc32c(crc, data, size);
+}
+
+inline void fill32(u32* dest, u32 value, usize count) {
+	table.fill32(dest, value, count);
+}
+
+inline void copy32(u32* dest, const u32* src, usize count) {
+	table.copy32(dest, src, count);
+}
+
+inline usize find_first_zero(const u64* bitmap, usize words) {
+	return table.find_first_zero(bitmap, words);
+}
+
+}
@@ -0,0 +1,93 @@
+#include <stl/string.hpp>
+#include <kernel/features.hpp>
+#include <kernel/log.hpp>
+#include <kernel/intrinsics.hpp>
+
+using namespace kernel::features;
+
+enum class Register {
+	EAX,
+	EBX,
+	ECX,
+	EDX,
+};
+
+// where a feature's bit lives in CPUID
+struct FeatureBit {
+	Feature feature;
+	u32 leaf;
+	u32 subleaf;
+	Register reg;
+	u32 bit;
+	mat::StringView name;
+};
+
+static constexpr FeatureBit FEATURE_BITS[] = {
+	{ Feature::ERMS, 7, 0, Register::EBX, 9, "erms" },
+	{ Feature::FSRM, 7, 0, Register::EDX, 4, "fsrm" },
+	{ Feature::SSE2, 1, 0, Register::EDX, 26, "sse2" },
+	{ Feature::SSE4_2, 1, 0, Register::ECX, 20, "sse4.2" },
+	{ Feature::AVX, 1, 0, Register::ECX, 28, "avx" },
+	{ Feature::AVX2, 7, 0, Register::EBX, 5, "avx2" },
+	{ Feature::AVX512F, 7, 0, Register::EBX, 16, "avx512f" },
+	{ Feature::XSAVE, 1, 0, Register::ECX, 26, "xsave" },
+	{ Feature::XSAVEOPT, 0xd, 1, Register::EAX, 0, "xsaveopt" },
+	{ Feature::XSAVES, 0xd, 1, Register::EAX, 3, "xsaves" },
+	{ Feature::POPCNT, 1, 0, Register::ECX, 23, "popcnt" },
+	{ Feature::BMI1, 7, 0, Register::EBX, 3, "bmi1" },
+	{ Feature::BMI2, 7, 0, Register::EBX, 8, "bmi2" },
+	{ Feature::InvariantTSC, 0x80000007, 0, Register::EDX, 8, "invariant_tsc" },
+	{ Feature::TSCDeadline, 1, 0, Register::ECX, 24, "tsc_deadline" },
+	{ Feature::PCID, 1, 0, Register::ECX, 17, "pcid" },
+	{ Feature::INVPCID, 7, 0, Register::EBX, 10, "invpcid" },
+	{ Feature::X2APIC, 1, 0, Register::ECX, 21, "x2apic" },
+	{ Feature::Pages1G, 0x80000001, 0, Register::EDX, 26, "pages_1g" },
+	{ Feature::MWAIT, 1, 0, Register::ECX, 3, "mwait" },
+	{ Feature::RDTSCP, 0x80000001, 0, Register::EDX, 27, "rdtscp" },
+};
+static_assert(sizeof(FEATURE_BITS) / sizeof(FEATURE_BITS[0]) == static_cast<usize>(Feature::Count));
+static_assert(static_cast<usize>(Feature::Count) <= 64);
+
+static u64 supported = 0;
+
+static u32 read_register(const CPUIDResult& result, Register reg) {
+	switch (reg) {
+		case Register::EAX: return result.eax;
+		case Register::EBX: return result.ebx;
+		case Register::ECX: return result.ecx;
+		case Register::EDX: return result.edx;
+	}
+	return 0;
+}
+
+void kernel::features::init() {
+	// asking for a leaf past the maximum returns garbage from the highest one instead
+	const auto max_basic = cpuid(0).eax;
+	const auto max_extended = cpuid(0x80000000).eax;
+
+	for (const auto& entry : FEATURE_BITS) {
+		const auto max = entry.leaf >= 0x80000000 ? max_extended : max_basic;
+		if (entry.leaf > max) continue;
+
+		if (read_register(cpuid(entry.leaf, entry.subleaf), entry.reg) & (u32(1) << entry.bit)) {
+			supported |= u64(1) << static_cast<u32>(entry.feature);
+		}
+	}
+
+	dump();
+	kdbgln("CPU features initialized");
+}
+
+bool kernel::features::has(Feature feature) {
+	return supported & (u64(1) << static_cast<u32>(feature));
+}
+
+void kernel::features::dump() {
+	kdbg("[features]");
+	for (const auto& entry : FEATURE_BITS) {
+		if (has(entry.feature)) {
+			kdbg(" {}", entry.name);
+		}
+	}
+	kdbgln("");
+}
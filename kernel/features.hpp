@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stl/types.hpp>
+
+namespace kernel::features {
+
+// CPU features the kernel cares about, read from CPUID once at boot.
+// These say what the CPU supports, not whether the kernel turned it on (like the SIMD ones).
+enum class Feature : u32 {
+	// enhanced rep movsb/stosb, and fast short rep movsb
+	ERMS,
+	FSRM,
+	SSE2,
+	SSE4_2,
+	AVX,
+	AVX2,
+	AVX512F,
+	XSAVE,
+	// xsave that skips unmodified state, and the compacted one that can save supervisor state
+	XSAVEOPT,
+	XSAVES,
+	POPCNT,
+	BMI1,
+	BMI2,
+	InvariantTSC,
+	TSCDeadline,
+	PCID,
+	INVPCID,
+	X2APIC,
+	// 1 GiB pages
+	Pages1G,
+	MWAIT,
+	RDTSCP,
+
+	Count
+};
+
+// Reads every feature from CPUID on the bootstrap CPU. The others are assumed to match.
+// Must be called before anything checks a feature.
+void init();
+
+bool has(Feature feature);
+
+// Prints the supported features over serial.
+void dump();
+
+}
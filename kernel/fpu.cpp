@@ -0,0 +1,256 @@
+#include <kernel/fpu.hpp>
+#include <kernel/alternatives.hpp>
+#include <kernel/features.hpp>
+#include <kernel/cpu.hpp>
+#include <kernel/sched/scheduler.hpp>
+#include <kernel/memory/allocator.hpp>
+#include <kernel/log.hpp>
+#include <kernel/intrinsics.hpp>
+
+using namespace kernel;
+using features::Feature;
+using alternatives::static_has;
+
+static constexpr u64 CR0_MP = 1 << 1;
+static constexpr u64 CR0_EM = 1 << 2;
+static constexpr u64 CR0_TS = 1 << 3;
+static constexpr u64 CR0_NE = 1 << 5;
+static constexpr u64 CR4_OSFXSR = 1 << 9;
+static constexpr u64 CR4_OSXMMEXCPT = 1 << 10;
+static constexpr u64 CR4_OSXSAVE = 1 << 18;
+
+static constexpr u64 XCR0_X87 = 1 << 0;
+static constexpr u64 XCR0_SSE = 1 << 1;
+static constexpr u64 XCR0_AVX = 1 << 2;
+// opmask registers, upper halves of zmm0-15, and zmm16-31
+static constexpr u64 XCR0_AVX512 = 0b111 << 5;
+
+static constexpr u32 IA32_XSS_MSR = 0xda0;
+
+// where things are in the save area
+static constexpr usize FCW_OFFSET = 0;
+static constexpr usize MXCSR_OFFSET = 24;
+static constexpr usize XCOMP_BV_OFFSET = 520;
+// marks an area as being in the compacted format xsaves uses
+static constexpr u64 XCOMP_BV_COMPACTED = u64(1) << 63;
+static constexpr usize FXSAVE_AREA_SIZE = 512;
+
+static constexpr u16 DEFAULT_FCW = 0x37f;
+static constexpr u32 DEFAULT_MXCSR = 0x1f80;
+
+// state components saved and restored, also what XCR0 gets set to
+static u64 xcr0 = 0;
+static usize area_size = FXSAVE_AREA_SIZE;
+
+static void set_usable(fpu::CPUState& state, bool usable) {
+	if (state.usable == usable) return;
+	state.usable = usable;
+	if (usable) {
+		asm volatile("clts" : : : "memory");
+	} else {
+		set_cr0(get_cr0() | CR0_TS);
+	}
+}
+
+// the xsave instructions all take the components to save in edx:eax.
+// the best one for the CPU gets patched in by `alternatives::init`
+static void save(u8* area) {
+	const u32 low = u32(xcr0);
+	const u32 high = u32(xcr0 >> 32);
+	if (static_has(Feature::XSAVES)) {
+		asm volatile("xsaves64 (%0)" : : "r"(area), "a"(low), "d"(high) : "memory");
+	} else if (static_has(Feature::XSAVEOPT)) {
+		asm volatile("xsaveopt64 (%0)" : : "r"(area), "a"(low), "d"(high) : "memory");
+	} else if (static_has(Feature::XSAVE)) {
+		asm volatile("xsave64 (%0)" : : "r"(area), "a"(low), "d"(high) : "memory");
+	} else {
+		asm volatile("fxsave64 (%0)" : : "r"(area) : "memory");
+	}
+}
+
+static void restore(const u8* area) {
+	const u32 low = u32(xcr0);
+	const u32 high = u32(xcr0 >> 32);
+	if (static_has(Feature::XSAVES)) {
+		asm volatile("xrstors64 (%0)" : : "r"(area), "a"(low), "d"(high) : "memory");
+	} else if (static_has(Feature::XSAVE)) {
+		asm volatile("xrstor64 (%0)" : : "r"(area), "a"(low), "d"(high) : "memory");
+	} else {
+		asm volatile("fxrstor64 (%0)" : : "r"(area) : "memory");
+	}
+}
+
+// A fresh area, which restores to the initial state.
+static u8* allocate_area() {
+	const auto pages = (area_size + PAGE_SIZE - 1) / PAGE_SIZE;
+	auto* area = static_cast<u8*>(alloc::allocate_pages(pages));
+	for (usize i = 0; i < pages; ++i) {
+		paging::clear_page(VirtualAddress(area + i * PAGE_SIZE));
+	}
+
+	// with the xsave header all zero every component gets its initial state anyways,
+	// fxrstor loads these as they are though
+	*reinterpret_cast<u16*>(area + FCW_OFFSET) = DEFAULT_FCW;
+	*reinterpret_cast<u32*>(area + MXCSR_OFFSET) = DEFAULT_MXCSR;
+	if (static_has(Feature::XSAVES)) {
+		*reinterpret_cast<u64*>(area + XCOMP_BV_OFFSET) = XCOMP_BV_COMPACTED | xcr0;
+	}
+	return area;
+}
+
+// whether the registers holds `thread`'s state, which only it has changed since
+static bool is_live(const CPU* cpu, const sched::Thread* thread) {
+	return cpu->fpu.owner == thread && thread->fpu.last_cpu == cpu->id && thread->fpu.depth;
+}
+
+void kernel::fpu::init() {
+	xcr0 = XCR0_X87 | XCR0_SSE;
+	if (features::has(Feature::XSAVE)) {
+		// AVX needs its upper halves saved, which only xsave knows about
+		if (features::has(Feature::AVX)) xcr0 |= XCR0_AVX;
+		if (features::has(Feature::AVX512F) && (xcr0 & XCR0_AVX)) xcr0 |= XCR0_AVX512;
+		// only the components the CPU has can be turned on
+		const auto supported = cpuid(0xd, 0);
+		xcr0 &= supported.eax | (u64(supported.edx) << 32);
+	}
+
+	init_cpu();
+
+	if (features::has(Feature::XSAVE)) {
+		// the sizes depend on what's enabled, so they're only right after setting XCR0
+		area_size = static_has(Feature::XSAVES) ? cpuid(0xd, 1).ebx : cpuid(0xd, 0).ebx;
+	}
+
+	kdbgln("[fpu] saving with {}, {} byte areas, xcr0 {:#x}",
+		static_has(Feature::XSAVES) ? "xsaves" : static_has(Feature::XSAVEOPT) ? "xsaveopt" :
+		static_has(Feature::XSAVE) ? "xsave" : "fxsave", area_size, xcr0);
+	kdbgln("FPU initialized");
+}
+
+void kernel::fpu::init_cpu() {
+	// EM would make every SIMD instruction fault, and MP makes fwait respect TS too.
+	// TS stays set until something calls `begin`
+	set_cr0((get_cr0() & ~CR0_EM) | CR0_MP | CR0_NE | CR0_TS);
+
+	auto cr4 = get_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT;
+	if (features::has(Feature::XSAVE)) cr4 |= CR4_OSXSAVE;
+	set_cr4(cr4);
+
+	if (features::has(Feature::XSAVE)) {
+		asm volatile("xsetbv" : : "c"(0), "a"(u32(xcr0)), "d"(u32(xcr0 >> 32)) : "memory");
+		// no supervisor state is used, but xsaves still goes by this
+		if (static_has(Feature::XSAVES)) wrmsr(IA32_XSS_MSR, 0);
+	}
+
+	auto& state = this_cpu()->fpu;
+	state.usable = false;
+	set_usable(state, true);
+	const u32 mxcsr = DEFAULT_MXCSR;
+	asm volatile("fninit; ldmxcsr %0" : : "m"(mxcsr) : "memory");
+	set_usable(state, false);
+}
+
+bool kernel::fpu::avx_enabled() {
+	return xcr0 & XCR0_AVX;
+}
+
+static bool preemptible() {
+	const auto& state = this_cpu()->sched;
+	return sched::can_block() && state.irq_depth == 0 && state.preempt_count == 0 && interrupts_enabled();
+}
+
+void kernel::fpu::begin() {
+	if (preemptible()) {
+		auto* thread = sched::current();
+		if (!thread->fpu.area) {
+			thread->fpu.area = allocate_area();
+		}
+		// nothing is loaded yet, the first SIMD instruction traps if the registers aren't this thread's
+		thread->fpu.depth++;
+		return;
+	}
+
+	const auto flags = irq_save();
+	auto* cpu = this_cpu();
+	auto& state = cpu->fpu;
+	// interrupts were already off for the inner ones, the outermost one restores them
+	if (state.borrowed++) return;
+	state.borrow_flags = flags;
+	state.borrows++;
+
+	// a thread was interrupted in the middle of using them, and gets them back with a trap.
+	// anyone else had their state saved when they were switched out
+	auto* owner = state.owner;
+	if (owner && state.usable && is_live(cpu, owner)) {
+		save(owner->fpu.area);
+		state.saves++;
+	}
+	state.owner = nullptr;
+	set_usable(state, true);
+}
+
+void kernel::fpu::end() {
+	// a preemptible thread may move between these, but then it isn't borrowing on either CPU
+	auto& state = this_cpu()->fpu;
+	if (state.borrowed) {
+		if (--state.borrowed) return;
+		set_usable(state, false);
+		irq_restore(state.borrow_flags);
+		return;
+	}
+
+	auto* thread = sched::current();
+	if (!thread || !thread->fpu.depth) {
+		panic("fpu::end without a matching fpu::begin");
+	}
+	thread->fpu.depth--;
+}
+
+bool kernel::fpu::handle_trap() {
+	auto* cpu = this_cpu();
+	auto& state = cpu->fpu;
+	auto* thread = cpu->sched.current;
+	if (state.borrowed || cpu->sched.irq_depth || !thread || !thread->fpu.depth) return false;
+
+	// whoever had the registers before isn't running, so their state is saved already
+	set_usable(state, true);
+	restore(thread->fpu.area);
+	state.owner = thread;
+	thread->fpu.last_cpu = cpu->id;
+	state.restores++;
+	return true;
+}
+
+void kernel::fpu::switch_out(sched::Thread* prev) {
+	auto* cpu = this_cpu();
+	auto& state = cpu->fpu;
+	if (state.borrowed) {
+		panic("Switched away from thread {} ({}) while borrowing the SIMD registers", prev->id, prev->name);
+	}
+
+	// saved every time, so it can be loaded on any CPU.
+	// it's loading that's lazy, the registers are left as they are until someone else needs them
+	if (state.usable && is_live(cpu, prev)) {
+		save(prev->fpu.area);
+		state.saves++;
+	}
+}
+
+void kernel::fpu::switch_in(sched::Thread* next) {
+	auto* cpu = this_cpu();
+	auto& state = cpu->fpu;
+	const bool live = is_live(cpu, next);
+	if (live) state.lazy_hits++;
+	set_usable(state, live);
+}
+
+void kernel::fpu::dump_stats() {
+	kdbgln("[fpu] restores, saves, switches without a restore, borrows");
+	for (u32 id = 0; id < cpu::count(); ++id) {
+		const auto* cpu = cpu::get(id);
+		if (!cpu->online) continue;
+
+		const auto& state = cpu->fpu;
+		kdbgln("[fpu] cpu {}: {}, {}, {}, {}", id, state.restores, state.saves, state.lazy_hits, state.borrows);
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stl/types.hpp>
+
+namespace kernel {
+
+namespace sched {
+struct Thread;
+}
+
+namespace fpu {
+
+// not on any CPU
+static constexpr u32 NO_CPU = ~u32(0);
+
+// SIMD state of a thread, part of the thread.
+struct ThreadState {
+	// xsave area (or fxsave area, on CPUs without xsave), allocated on first use
+	u8* area = nullptr;
+	// how many `begin`s deep the thread is, the area only matters while this isn't 0
+	u32 depth = 0;
+	// the CPU whose registers hold this thread's state, if any
+	u32 last_cpu = NO_CPU;
+};
+
+// SIMD state of a CPU, part of the per-CPU data.
+struct CPUState {
+	// whose state is in the registers. only counts if the thread agrees through `last_cpu`
+	sched::Thread* owner = nullptr;
+	// mirrors CR0.TS being clear, reading CR0 is a lot slower
+	bool usable = false;
+	// how many `begin`s deep something that isn't a preemptible thread is, while it borrows the registers
+	u32 borrowed = 0;
+	// interrupts are disabled while borrowing, this is what they were before
+	u64 borrow_flags = 0;
+
+	// threads that trapped on their first SIMD instruction and got their state loaded
+	u64 restores = 0;
+	u64 saves = 0;
+	// switched back to a thread whose state was still in the registers, so nothing was loaded
+	u64 lazy_hits = 0;
+	u64 borrows = 0;
+};
+
+// Enables SSE, and AVX and xsave where supported, on the bootstrap CPU and works out the
+// size of the save area. Must be called after `alternatives::init`, and before anything uses SIMD.
+void init();
+
+// Enables the same on the calling CPU, for the others as they start.
+void init_cpu();
+
+// Whether AVX state is saved and restored, so AVX code can run between `begin` and `end`.
+bool avx_enabled();
+
+// Makes the SIMD registers usable until the matching `end`. Code compiled with SIMD enabled
+// may only run in between, and has to live in its own translation unit, since the compiler
+// is free to use SIMD registers anywhere in a function it was allowed to.
+//
+// In a preemptible thread the registers become part of the thread, saved when it's switched
+// out and loaded again lazily, on the first SIMD instruction after it's switched back in.
+// Anywhere else (interrupt handlers, with preemption or interrupts disabled, or before
+// scheduling started) the registers are only borrowed, with interrupts disabled until `end`.
+void begin();
+void end();
+
+// Scoped `begin` and `end`.
+struct Guard {
+	Guard() { begin(); }
+	~Guard() { end(); }
+
+	Guard(const Guard&) = delete;
+	Guard& operator=(const Guard&) = delete;
+};
+
+// Called from the #NM handler, when a SIMD instruction ran while the registers weren't usable.
+// Returns whether it was handled, it isn't outside of a `begin`.
+bool handle_trap();
+
+// Called by the scheduler, with interrupts disabled, around every thread switch.
+void switch_out(sched::Thread* prev);
+void switch_in(sched::Thread* next);
+
+// Prints the save and restore counts of every CPU over serial.
+void dump_stats();
+
+}
+
+}
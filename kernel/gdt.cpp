@@ -0,0 +1,49 @@
+#include <kernel/gdt.hpp>
+
+using namespace kernel::gdt;
+
+// present, ring 0, code/data, and long mode for code
+static constexpr u64 SEGMENT_CODE = (u64(0b1001'1010) << 40) | (u64(1) << 53);
+static constexpr u64 SEGMENT_DATA = u64(0b1001'0010) << 40;
+// present, ring 0, 64-bit available TSS
+static constexpr u64 SEGMENT_TSS = u64(0b1000'1001) << 40;
+
+void kernel::gdt::load(GDT* gdt, void* double_fault_stack) {
+	gdt->tss = TSS();
+	gdt->tss.ist[DOUBLE_FAULT_IST - 1] = reinterpret_cast<uptr>(double_fault_stack);
+
+	for (auto& entry : gdt->entries) {
+		entry = 0;
+	}
+	gdt->entries[KERNEL_CODE_SELECTOR / 8] = SEGMENT_CODE;
+	gdt->entries[KERNEL_DATA_SELECTOR / 8] = SEGMENT_DATA;
+
+	// the TSS descriptor is 16 bytes, with the rest of the base in the second half
+	const auto base = reinterpret_cast<uptr>(&gdt->tss);
+	const u64 limit = sizeof(TSS) - 1;
+	gdt->entries[TSS_SELECTOR / 8] = SEGMENT_TSS | (limit & 0xFFFF) | ((base & 0xFFFFFF) << 16) | (((base >> 24) & 0xFF) << 56);
+	gdt->entries[TSS_SELECTOR / 8 + 1] = base >> 32;
+
+	struct [[gnu::packed]] {
+		u16 size;
+		void* addr;
+	} gdt_register { sizeof(gdt->entries) - 1, &gdt->entries[0] };
+
+	// cs can only be changed with a far jump or return
+	asm volatile(R"asm(
+		lgdt %0
+		pushq %1
+		leaq 1f(%%rip), %%rax
+		pushq %%rax
+		lretq
+	1:
+		movw %2, %%ax
+		movw %%ax, %%ds
+		movw %%ax, %%es
+		movw %%ax, %%ss
+		xorw %%ax, %%ax
+		movw %%ax, %%fs
+		movw %%ax, %%gs
+		ltr %3
+	)asm" : : "m"(gdt_register), "i"(u64(KERNEL_CODE_SELECTOR)), "i"(KERNEL_DATA_SELECTOR), "r"(TSS_SELECTOR) : "rax", "memory");
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stl/types.hpp>
+
+namespace kernel {
+
+// Same selectors limine uses, so nothing referring to them needs to change
+// after switching over from limine's GDT.
+static constexpr u16 KERNEL_CODE_SELECTOR = 5 << 3;
+static constexpr u16 KERNEL_DATA_SELECTOR = 6 << 3;
+static constexpr u16 TSS_SELECTOR = 7 << 3;
+
+// Interrupt stack table index for the double fault handler, so that a kernel
+// stack overflow ends in a proper panic instead of a triple fault.
+static constexpr u8 DOUBLE_FAULT_IST = 1;
+
+namespace gdt {
+
+struct [[gnu::packed]] TSS {
+	u32 reserved0 = 0;
+	u64 rsp[3] = {};
+	u64 reserved1 = 0;
+	// ist[0] is IST 1
+	u64 ist[7] = {};
+	u64 reserved2 = 0;
+	u16 reserved3 = 0;
+	u16 iomap_base = sizeof(TSS);
+};
+
+static_assert(sizeof(TSS) == 104);
+
+// Each CPU has its own, since the TSS descriptor is marked busy once loaded.
+struct GDT {
+	// null, 4 unused (limine's 16 and 32 bit segments), code, data and the TSS, which takes two
+	u64 entries[9] = {};
+	TSS tss;
+};
+
+// Fills in `gdt` and loads it on the calling CPU, reloading every segment register
+// and the task register. `double_fault_stack` is the top of the stack for DOUBLE_FAULT_IST.
+// Note that this clears the GS base, so it has to be set afterwards.
+void load(GDT* gdt, void* double_fault_stack);
+
+}
+
+}
@@ -0,0 +1,96 @@
+#include <kernel/idle.hpp>
+#include <kernel/time/time.hpp>
+#include <kernel/irq_trace.hpp>
+#include <kernel/cpu.hpp>
+#include <kernel/log.hpp>
+#include <kernel/features.hpp>
+#include <kernel/intrinsics.hpp>
+
+using namespace kernel;
+
+static bool mwait_supported = false;
+static bool use_mwait = false;
+
+// when the stats started, to turn residency into a percentage
+static u64 start_cycles = 0;
+
+void kernel::idle::init() {
+	// leaf 5 describes the monitor line size and mwait extensions, it has to be there too
+	mwait_supported = features::has(features::Feature::MWAIT) && cpuid(0).eax >= 5;
+	use_mwait = mwait_supported;
+	start_cycles = rdtsc();
+
+	kdbgln("Idle initialized, waiting with {}", use_mwait ? "mwait" : "hlt");
+}
+
+bool kernel::idle::using_mwait() {
+	return __atomic_load_n(&use_mwait, __ATOMIC_RELAXED);
+}
+
+void kernel::idle::set_mwait(bool enabled) {
+	__atomic_store_n(&use_mwait, enabled && mwait_supported, __ATOMIC_RELAXED);
+}
+
+void kernel::idle::wait(bool* flag) {
+	auto& state = this_cpu()->idle;
+	const auto start = rdtsc();
+
+	if (using_mwait()) {
+		// wakers check this after writing the flag, and the flag gets checked again
+		// below after arming the monitor, so a write can't slip in between unnoticed
+		__atomic_store_n(&state.polling, true, __ATOMIC_SEQ_CST);
+		asm volatile("monitor" : : "a"(flag), "c"(0), "d"(0) : "memory");
+		if (!__atomic_load_n(flag, __ATOMIC_RELAXED)) {
+			// like with hlt, sti only takes effect once mwait started waiting.
+			// the 0 hint asks for C1, deeper states take longer to wake up from
+			trace_irqs_on();
+			asm volatile("sti; mwait; cli" : : "a"(0), "c"(0) : "memory");
+			trace_irqs_off();
+		}
+		__atomic_store_n(&state.polling, false, __ATOMIC_RELAXED);
+	} else if (!__atomic_load_n(flag, __ATOMIC_RELAXED)) {
+		trace_irqs_on();
+		asm volatile("sti; hlt; cli" : : : "memory");
+		trace_irqs_off();
+	}
+
+	const auto end = rdtsc();
+	state.entries++;
+	state.residency_cycles += end - start;
+
+	// the TSC is synchronized between CPUs, so this works even though another CPU wrote it
+	const auto wake_start = __atomic_exchange_n(&state.wake_start, 0, __ATOMIC_RELAXED);
+	if (wake_start && end > wake_start) {
+		const auto cycles = end - wake_start;
+		state.wake_count++;
+		state.wake_total_cycles += cycles;
+		if (cycles > state.wake_max_cycles) state.wake_max_cycles = cycles;
+	}
+}
+
+bool kernel::idle::wake(CPU* cpu, bool* flag) {
+	auto& state = cpu->idle;
+	__atomic_store_n(&state.wake_start, rdtsc(), __ATOMIC_RELAXED);
+	// pairs with the polling store in `wait`, one of the two sides always sees the other
+	__atomic_store_n(flag, true, __ATOMIC_SEQ_CST);
+	if (!__atomic_load_n(&state.polling, __ATOMIC_SEQ_CST)) return false;
+
+	__atomic_fetch_add(&state.polled_wakes, 1, __ATOMIC_RELAXED);
+	return true;
+}
+
+void kernel::idle::dump_stats() {
+	const auto total = rdtsc() - start_cycles;
+	kdbgln("[idle] waiting with {}", using_mwait() ? "mwait" : "hlt");
+	kdbgln("[idle] entries, residency, wakes without IPI, avg wake latency, max");
+	for (u32 id = 0; id < cpu::count(); ++id) {
+		const auto* cpu = cpu::get(id);
+		if (!cpu->online) continue;
+
+		const auto& state = cpu->idle;
+		kdbgln("[idle] cpu {}: {}, {}%, {}, {}ns, {}ns", id, state.entries,
+			total ? state.residency_cycles * 100 / total : 0, state.polled_wakes,
+			state.wake_count ? time::cycles_to_ns(state.wake_total_cycles / state.wake_count) : 0,
+			time::cycles_to_ns(state.wake_max_cycles));
+	}
+}
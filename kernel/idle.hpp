@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stl/types.hpp>
+
+namespace kernel {
+
+struct CPU;
+
+namespace idle {
+
+// Idle stats of a CPU, part of the per-CPU data.
+struct CPUState {
+	// set while waiting in mwait, when a write to the flag is enough to wake this CPU
+	bool polling = false;
+	// TSC value of the latest `wake` aimed at this CPU, cleared once it's awake
+	u64 wake_start = 0;
+
+	// how many times the CPU went idle, and for how long in total
+	u64 entries = 0;
+	u64 residency_cycles = 0;
+	// wake ups that got away without an IPI
+	u64 polled_wakes = 0;
+	// from `wake` until this CPU was running again
+	u64 wake_count = 0;
+	u64 wake_total_cycles = 0;
+	u64 wake_max_cycles = 0;
+};
+
+// Checks whether monitor/mwait can be used. Must be called on the bootstrap CPU
+// before the others start.
+void init();
+
+// Whether idle CPUs are waiting with mwait, instead of hlt.
+bool using_mwait();
+
+// Switches between mwait and hlt, for comparing them. Only does anything if mwait is supported.
+void set_mwait(bool enabled);
+
+// Waits until an interrupt comes in, or, when mwait is used, until something writes to `*flag`.
+// Returns right away if `*flag` is already set. Must be called with interrupts disabled, and
+// returns with them still disabled, after handling the interrupt that woke it (if any).
+void wait(bool* flag);
+
+// Sets `*flag` on `cpu`, which should be idle or about to be. Returns whether that
+// was enough to wake it up, if it isn't waiting in mwait it still needs an interrupt.
+bool wake(CPU* cpu, bool* flag);
+
+// Prints the idle residency and wake up stats of every CPU over serial.
+void dump_stats();
+
+}
+
+}
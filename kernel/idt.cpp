@@ -1,10 +1,13 @@
 #include <stl/types.hpp>
 #include <kernel/idt.hpp>
+#include <kernel/gdt.hpp>
+#include <kernel/deferred.hpp>
+#include <kernel/irq_stats.hpp>
+#include <kernel/cpu.hpp>
+#include <kernel/sched/scheduler.hpp>
+#include <kernel/sync/rcu.hpp>
 #include <kernel/log.hpp>
 #include <kernel/intrinsics.hpp>
-#include <kernel/device/pic.hpp>
-#include <kernel/device/ps2.hpp>
-#include <kernel/device/pit.hpp>
 
 struct IDTEntry {
 	u16 offset1;
@@ -31,15 +34,19 @@ struct IDTEntry {
 	}
 
 	// https://github.com/limine-bootloader/limine/blob/v5.x-branch/PROTOCOL.md#x86_64
-	// 64-bit code descriptor is on index 5, so 0b101
+	// 64-bit code descriptor is on index 5, so 0b101, and our own GDT keeps it there.
 	// last 3 bits should be 0, since i want to use the GDT and be on ring 0
-	IDTEntry(const void* address) : IDTEntry(address, 0b101'000, 0, GateType::Interrupt) {}
+	IDTEntry(const void* address) : IDTEntry(address, kernel::KERNEL_CODE_SELECTOR, 0, GateType::Interrupt) {}
 
 	IDTEntry() : IDTEntry(nullptr) {}
 };
 
 static IDTEntry idt_table[256];
 
+// published with rcu::assign, and only called inside a read-side section,
+// so whoever replaces one knows when the old one isn't running anymore
+static kernel::idt::IrqHandler irq_handlers[256];
+
 static struct [[gnu::packed]] {
 	u16 size;
 	void* addr;
@@ -99,6 +106,8 @@ struct Registers {
 	u64 r12;
 	u64 r11;
 	u64 r10;
+	// pushed by the cpu for some exceptions, and as 0 by the stub for everything else
+	u64 error_code;
 	// pushed by the cpu
 	u64 rip;
 	u64 cs;
@@ -111,6 +120,7 @@ enum class InterruptId : u64 {
 	NMI = 2,
 	Breakpoint = 3,
 	InvalidOpcode = 6,
+	DeviceNotAvailable = 7,
 	DoubleFault = 8,
 	SegmentNotPresent = 11,
 	GeneralProtectionFault = 13,
@@ -139,7 +149,7 @@ static mat::StringView get_interrupt_name(u64 idx) {
 		case 0x11: return "Alignment check";
 		case 0x12: return "Machine check";
 		case 0x13: return "SIMD Floating-Point Exception";
-		case kernel::PIC_IRQ_OFFSET + 1: return "Keyboard";
+		case kernel::IRQ_VECTOR_BASE + 1: return "Keyboard";
 		default:
 			return "Unknown";
 	}
@@ -149,7 +159,11 @@ static mat::StringView get_interrupt_name(u64 idx) {
 // error_code - rsi
 // regs - rdx
 static void kernel_interrupt_handler(u64 which, u64 error_code, Registers* regs) {
-	if (which < kernel::PIC_IRQ_OFFSET) {
+	if (which < kernel::IRQ_VECTOR_BASE) {
+		// SIMD used while the registers weren't loaded, which is expected inside fpu::begin
+		if (which == u64(InterruptId::DeviceNotAvailable) && kernel::fpu::handle_trap()) {
+			return;
+		}
 		kdbgln("[INT] ({:#x}) {}, with error code {:#x}", which, get_interrupt_name(which), error_code);
 		const auto id = static_cast<InterruptId>(which);
 		if (id == InterruptId::PageFault) {
@@ -169,15 +183,37 @@ static void kernel_interrupt_handler(u64 which, u64 error_code, Registers* regs)
 		kdbgln("rip - {:#x}", regs->rip);
 		kdbgln("rsp - {:#x}", regs->rsp);
 		halt();
+	} else if (which == kernel::SPURIOUS_VECTOR) {
+		// spurious interrupts must not be acknowledged
+		return;
 	} else {
-		if (which == kernel::PIC_IRQ_OFFSET + 0) {
-			kernel::pit::handle_interrupt();
-		} else if (which == kernel::PIC_IRQ_OFFSET + 1) {
-			kernel::ps2::handle_keyboard();
-		} else {
-			kdbgln("[INT] ({:#x}) Unknown IRQ {}, error code {:#x}", which, which - kernel::PIC_IRQ_OFFSET, error_code);
+		kernel::rcu::read_lock();
+		const auto handler = kernel::rcu::dereference(irq_handlers[which]);
+		if (!handler) {
+			kdbgln("[INT] ({:#x}) Unknown IRQ {}, error code {:#x}", which, which - kernel::IRQ_VECTOR_BASE, error_code);
 			halt();
 		}
+
+		// interrupts got disabled by the interrupt gate, and come back on with the iretq
+		trace_irqs_off();
+		auto& sched_state = kernel::this_cpu()->sched;
+		sched_state.irq_depth++;
+
+		const auto start = rdtsc();
+		handler();
+		kernel::irq_stats::record(which, rdtsc() - start);
+		// has to be over before switching threads below
+		kernel::rcu::read_unlock();
+		// the handler already acknowledged the interrupt, so anything it deferred
+		// can run now without blocking further interrupts
+		kernel::deferred::run_pending();
+
+		// only the outermost interrupt may switch threads, the others would
+		// leave the one they interrupted halfway done
+		if (--sched_state.irq_depth == 0) {
+			kernel::sched::handle_irq_exit();
+		}
+		trace_irqs_on();
 	}
 }
 
@@ -185,29 +221,74 @@ static void kernel_interrupt_handler(u64 which, u64 error_code, Registers* regs)
 // maybe its just not possible on 64 bit
 static auto* kernel_interrupt_handler_ptr = &kernel_interrupt_handler;
 
+// both of these clear the direction flag, it may be set in whatever got interrupted,
+// but the compiler expects it clear for any rep movs or stos it emits.
+// with the error code the stack is off by 8, so it gets realigned around the call (rbx is saved already)
+
 template <u64 Number>
 [[gnu::naked]] void raw_interrupt_handler() {
-	asm(PUSH_REGS R"asm(
+	// pushes a fake error code, so that the stack looks the same as for an error handler
+	asm("pushq $0;\n\t" PUSH_REGS R"asm(
+		cld
 		movq %0, %%rdi
 		xor %%rsi, %%rsi
 		movq %%rsp, %%rdx
+		movq %%rsp, %%rbx
+		andq $-16, %%rsp
 		call *%1
-	)asm" POP_REGS "iretq" : /* output */ : "i"(Number), "m"(kernel_interrupt_handler_ptr));
+		movq %%rbx, %%rsp
+	)asm" POP_REGS "addq $8, %%rsp; iretq" : /* output */ : "i"(Number), "m"(kernel_interrupt_handler_ptr));
 }
 
-// a place to store the error code before the registers are saved
-u64 error_code_storage;
-
 template <u64 Number>
 [[gnu::naked]] void raw_interrupt_error_handler() {
-	// pops off the error code first,
-	// so that the stack looks the same to a non error handler
-	asm("popq %2;\n\t" PUSH_REGS R"asm(
+	// the error code stays on the stack, right above the saved registers,
+	// since another CPU may be handling an exception at the same time
+	asm(PUSH_REGS R"asm(
+		cld
 		movq %0, %%rdi
-		movq %2, %%rsi
+		movq 15*8(%%rsp), %%rsi
 		movq %%rsp, %%rdx
+		movq %%rsp, %%rbx
+		andq $-16, %%rsp
 		call *%1
-	)asm" POP_REGS "iretq" : /* output */ : "i"(Number), "m"(kernel_interrupt_handler_ptr), "m"(error_code_storage));
+		movq %%rbx, %%rsp
+	)asm" POP_REGS "addq $8, %%rsp; iretq" : /* output */ : "i"(Number), "m"(kernel_interrupt_handler_ptr));
+}
+
+// sets up the handlers for vectors First through Last, inclusive
+template <u64 First, u64 Last>
+static void install_irq_handlers() {
+	idt_table[First] = IDTEntry(reinterpret_cast<void*>(&raw_interrupt_handler<First>));
+	if constexpr (First < Last) {
+		install_irq_handlers<First + 1, Last>();
+	}
+}
+
+void kernel::idt::set_irq_handler(u8 vector, IrqHandler handler) {
+	if (vector < IRQ_VECTOR_BASE) {
+		panic("Tried to set an IRQ handler for exception vector {:#x}", vector);
+	}
+	const auto old = irq_handlers[vector];
+	kernel::rcu::assign(irq_handlers[vector], handler);
+	// another CPU may still be running the old one, so wait for it to be done before the
+	// caller tears down whatever it uses. during boot there's nothing else running anyway
+	if (old && old != handler && kernel::sched::can_block()) {
+		kernel::rcu::synchronize();
+	}
+}
+
+u8 kernel::idt::allocate_vector() {
+	// everything below this is either an exception or an ISA IRQ
+	static u8 next_vector = IRQ_VECTOR_BASE + 16;
+	if (next_vector >= LAPIC_TIMER_VECTOR) {
+		panic("Ran out of interrupt vectors");
+	}
+	return next_vector++;
+}
+
+void kernel::idt::load() {
+	asm volatile("lidt %0" : : "m"(idt_register));
 }
 
 void kernel::idt::init() {
@@ -224,15 +305,17 @@ void kernel::idt::init() {
 		((idt_table[Values] = IDTEntry(reinterpret_cast<void*>(&raw_interrupt_error_handler<Values>))), ...);
 	}).operator()<8, 10, 11, 12, 13, 14>();
 
-	// setup handlers for IRQs
-	([] <u64... Values> {
-		((idt_table[PIC_IRQ_OFFSET + Values] = IDTEntry(reinterpret_cast<void*>(&raw_interrupt_handler<PIC_IRQ_OFFSET + Values>))), ...);
-	}).operator()<0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15>();
+	// setup handlers for every IRQ vector, they get dispatched through irq_handlers
+	install_irq_handlers<IRQ_VECTOR_BASE, 0xFF>();
+
+	// double faults get their own stack, as they may come from overflowing the kernel stack
+	idt_table[static_cast<u64>(InterruptId::DoubleFault)].ist = DOUBLE_FAULT_IST;
 
 	idt_register.size = sizeof(idt_table) - 1;
 	idt_register.addr = &idt_table[0];
 
-	asm volatile("lidt %0; sti" : : "m"(idt_register));
+	load();
+	sti();
 
 	kdbgln("IDT initialized");
 }
\ No newline at end of file
@@ -1,7 +1,41 @@
 #pragma once
 
-namespace kernel::idt {
+#include <stl/types.hpp>
 
+namespace kernel {
+
+// Interrupt vector layout:
+// 0x00 - 0x1f: CPU exceptions
+// 0x20 - 0x2f: legacy ISA IRQs, routed through the I/O APIC
+// 0x30 - 0xef: free for other device interrupts
+// 0xf0 - 0xfe: local APIC interrupts and IPIs
+// 0xff: APIC spurious interrupt
+static constexpr u8 IRQ_VECTOR_BASE = 0x20;
+static constexpr u8 LAPIC_TIMER_VECTOR = 0xF0;
+static constexpr u8 TLB_SHOOTDOWN_VECTOR = 0xF1;
+static constexpr u8 RESCHEDULE_VECTOR = 0xF2;
+static constexpr u8 SPURIOUS_VECTOR = 0xFF;
+
+namespace idt {
+
+using IrqHandler = void(*)();
+
+// Fills in the IDT, loads it and enables interrupts.
 void init();
 
-}
\ No newline at end of file
+// Loads the already filled in IDT on the calling CPU.
+void load();
+
+// Sets the function to be called when an interrupt on `vector` happens.
+// The handler is responsible for acknowledging the interrupt, and should push
+// anything slow off to `deferred::queue`.
+// When replacing a handler from a thread, this waits until the old one isn't
+// running on any CPU anymore.
+void set_irq_handler(u8 vector, IrqHandler handler);
+
+// Reserves an unused vector in the device interrupt range, panics if there are none left.
+u8 allocate_vector();
+
+}
+
+}
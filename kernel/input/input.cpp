@@ -0,0 +1,227 @@
+#include <kernel/input/input.hpp>
+#include <kernel/sched/scheduler.hpp>
+#include <kernel/sync/spinlock.hpp>
+#include <kernel/time/time.hpp>
+#include <kernel/log.hpp>
+
+using namespace kernel;
+using namespace kernel::input;
+
+// how many events the router takes from each device at once
+static constexpr usize BATCH_SIZE = 32;
+
+static Consumer* focused = nullptr;
+
+// set by the devices when they have something queued, cleared by the router before it drains them
+static bool pending = false;
+static sync::WaitQueue router_waiters;
+
+static u64 routed = 0;
+static u64 unfocused = 0;
+
+void kernel::input::Consumer::deliver(const Event* events, usize count) {
+	usize delivered = 0;
+	for (usize i = 0; i < count; ++i) {
+		if (m_queue.push(events[i])) {
+			delivered++;
+		} else {
+			__atomic_fetch_add(&m_dropped, 1, __ATOMIC_RELAXED);
+		}
+	}
+	if (delivered) {
+		m_waiters.wake_all();
+	}
+}
+
+usize kernel::input::Consumer::poll(Event* events, usize max) {
+	const auto count = m_queue.pop_batch(events, max);
+	for (usize i = 0; i < count; ++i) {
+		note_read(events[i]);
+	}
+	return count;
+}
+
+usize kernel::input::Consumer::read(Event* events, usize max) {
+	while (true) {
+		if (const auto count = poll(events, max)) return count;
+		m_waiters.wait_until([this] { return !m_queue.is_empty(); });
+	}
+}
+
+static Event from_key(const keyboard::KeyEvent& key) {
+	Event event;
+	event.source = Source::Keyboard;
+	event.timestamp = key.timestamp;
+	event.key = key;
+	return event;
+}
+
+static Event from_mouse(const mouse::MouseEvent& mouse) {
+	Event event;
+	event.source = Source::Mouse;
+	event.timestamp = mouse.timestamp;
+	event.mouse = mouse;
+	return event;
+}
+
+// Events taken from a device but not routed yet, only touched by the router.
+template <class DeviceEvent>
+struct Pending {
+	DeviceEvent events[BATCH_SIZE];
+	usize start = 0;
+	usize count = 0;
+
+	// Moves what's left to the front and tops it up from the device.
+	void refill(usize (*poll)(DeviceEvent* events, usize max)) {
+		for (usize i = 0; i < count; ++i) {
+			events[i] = events[start + i];
+		}
+		start = 0;
+		count += poll(events + count, BATCH_SIZE - count);
+	}
+
+	// A full batch means the device may have more queued, all of them newer than the last one here.
+	u64 known_until() const {
+		return count == BATCH_SIZE ? events[start + count - 1].timestamp : ~u64(0);
+	}
+
+	bool has_until(u64 limit) const {
+		return count && events[start].timestamp <= limit;
+	}
+
+	const DeviceEvent& take() {
+		count--;
+		return events[start++];
+	}
+};
+
+static Pending<keyboard::KeyEvent> keys;
+static Pending<mouse::MouseEvent> moves;
+
+// Takes what the devices have queued, interleaving them by timestamp. Each device's events
+// are already in order, so this is just a merge. It only goes as far as every device is known
+// to have been read up to, the rest is carried over to the next call, once more has been read.
+static usize collect(Event* events) {
+	keys.refill(&keyboard::poll);
+	moves.refill(&mouse::poll);
+
+	// if both are full, the one ending sooner still gets used up, so this always makes progress
+	const auto key_limit = keys.known_until();
+	const auto move_limit = moves.known_until();
+	const auto limit = key_limit < move_limit ? key_limit : move_limit;
+
+	usize count = 0;
+	while (keys.has_until(limit) && moves.has_until(limit)) {
+		if (keys.events[keys.start].timestamp <= moves.events[moves.start].timestamp) {
+			events[count++] = from_key(keys.take());
+		} else {
+			events[count++] = from_mouse(moves.take());
+		}
+	}
+	while (keys.has_until(limit)) events[count++] = from_key(keys.take());
+	while (moves.has_until(limit)) events[count++] = from_mouse(moves.take());
+	return count;
+}
+
+static void route(void*) {
+	Event events[BATCH_SIZE * 2];
+	while (true) {
+		router_waiters.wait_until([] { return __atomic_load_n(&pending, __ATOMIC_ACQUIRE); });
+		// cleared before draining, so anything queued from here on sets it again
+		__atomic_store_n(&pending, false, __ATOMIC_RELEASE);
+
+		while (const auto count = collect(events)) {
+			__atomic_fetch_add(&routed, count, __ATOMIC_RELAXED);
+			auto* consumer = __atomic_load_n(&focused, __ATOMIC_ACQUIRE);
+			if (consumer) {
+				consumer->deliver(events, count);
+			} else {
+				__atomic_fetch_add(&unfocused, count, __ATOMIC_RELAXED);
+			}
+		}
+	}
+}
+
+void kernel::input::init() {
+	sched::spawn("input", &route, nullptr);
+	kdbgln("Input initialized");
+}
+
+void kernel::input::set_focus(Consumer* consumer) {
+	__atomic_store_n(&focused, consumer, __ATOMIC_RELEASE);
+}
+
+void kernel::input::notify() {
+	__atomic_store_n(&pending, true, __ATOMIC_RELEASE);
+	router_waiters.wake_all();
+}
+
+#ifdef INPUT_LATENCY
+
+struct Latency {
+	u64 count = 0;
+	u64 total = 0;
+	u64 min = ~u64(0);
+	u64 max = 0;
+
+	void record(u64 cycles) {
+		count++;
+		total += cycles;
+		if (cycles < min) min = cycles;
+		if (cycles > max) max = cycles;
+	}
+};
+
+// interrupt to consumer, and interrupt to framebuffer
+static Latency read_latency;
+static Latency display_latency;
+static sync::SpinLock latency_lock;
+
+void kernel::input::note_read(const Event& event) {
+	const auto now = time::cycles();
+	latency_lock.lock();
+	read_latency.record(now - event.timestamp);
+	latency_lock.unlock();
+}
+
+void kernel::input::note_displayed(const Event& event) {
+	// the framebuffer is usually write combining, so the pixels may still be sitting
+	// in a buffer. they only count as displayed once they've been flushed out
+	asm volatile("sfence" ::: "memory");
+	const auto now = time::ordered_cycles();
+	latency_lock.lock();
+	display_latency.record(now - event.timestamp);
+	latency_lock.unlock();
+}
+
+static void dump_latency(const char* name, const Latency& latency) {
+	if (!latency.count) {
+		kdbgln("[input] {}: no events", name);
+		return;
+	}
+	kdbgln("[input] {}: min {}ns, avg {}ns, max {}ns over {} events", name,
+		time::cycles_to_ns(latency.min),
+		time::cycles_to_ns(latency.total / latency.count),
+		time::cycles_to_ns(latency.max),
+		latency.count);
+}
+
+#endif
+
+void kernel::input::dump_stats() {
+	const auto* consumer = __atomic_load_n(&focused, __ATOMIC_ACQUIRE);
+	kdbgln("[input] routed {} events, {} without focus, {} dropped by the focused consumer",
+		__atomic_load_n(&routed, __ATOMIC_RELAXED), __atomic_load_n(&unfocused, __ATOMIC_RELAXED),
+		consumer ? consumer->dropped() : 0);
+
+#ifdef INPUT_LATENCY
+	latency_lock.lock();
+	const auto read = read_latency;
+	const auto display = display_latency;
+	latency_lock.unlock();
+	dump_latency("irq to read", read);
+	dump_latency("irq to framebuffer", display);
+#else
+	kdbgln("[input] latency tracing is disabled, build with -DINPUT_LATENCY=ON");
+#endif
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stl/types.hpp>
+#include <stl/ring.hpp>
+#include <kernel/device/keyboard.hpp>
+#include <kernel/device/mouse.hpp>
+#include <kernel/sync/wait_queue.hpp>
+
+namespace kernel::input {
+
+enum class Source : u8 {
+	Keyboard,
+	Mouse,
+};
+
+// An event from any input device, only the member matching `source` is filled in.
+struct Event {
+	Source source = Source::Keyboard;
+	// TSC value from when the interrupt came in, same as the device event's.
+	// compare against `time::cycles`
+	u64 timestamp = 0;
+	keyboard::KeyEvent key;
+	mouse::MouseEvent mouse;
+};
+
+// Something that input gets delivered to while it has focus, like the terminal.
+// The router is the only producer, and the owner the only consumer.
+class Consumer {
+	static constexpr usize QUEUE_SIZE = 128;
+
+	mat::SPSCRing<Event, QUEUE_SIZE> m_queue;
+	sync::WaitQueue m_waiters;
+	u64 m_dropped = 0;
+
+public:
+	// Queues events and wakes the owner up. Only for the router.
+	void deliver(const Event* events, usize count);
+
+	// Takes up to `max` events without blocking, returning how many there were.
+	usize poll(Event* events, usize max);
+
+	// Like `poll`, but blocks until there's at least one event. Threads only.
+	usize read(Event* events, usize max);
+
+	// Events that didn't fit in the queue.
+	u64 dropped() const { return __atomic_load_n(&m_dropped, __ATOMIC_RELAXED); }
+};
+
+// Starts the router thread, which takes events from every device and hands them to
+// the focused consumer in the order they came in. Must be called after `sched::init`.
+void init();
+
+// Gives `consumer` the focus, or takes it away from everyone if it's null.
+// Events that come in without a focused consumer are dropped.
+void set_focus(Consumer* consumer);
+
+// Lets the router know a device has new events queued. Safe from interrupt handlers.
+void notify();
+
+// Prints routing stats, and the latency ones if enabled, over serial.
+void dump_stats();
+
+#ifdef INPUT_LATENCY
+// Records how long `event` took from its interrupt until the consumer read it.
+void note_read(const Event& event);
+
+// Records how long `event` took from its interrupt until whatever it caused was written
+// to the framebuffer. Call right after the write.
+void note_displayed(const Event& event);
+#else
+inline void note_read(const Event&) {}
+inline void note_displayed(const Event&) {}
+#endif
+
+}
@@ -19,12 +19,21 @@ inline void outb(u16 port, u8 value) {
 	}
 }
 
+// Hint for spin loops, lets the CPU back off a bit instead of hammering memory.
+inline void cpu_relax() {
+	asm volatile("pause" : : : "memory");
+}
+
 inline u64 get_cr0() {
 	u64 value;
 	asm("movq %%cr0, %0" : "=r"(value));
 	return value;
 }
 
+inline void set_cr0(u64 value) {
+	asm volatile("movq %0, %%cr0" : : "r"(value) : "memory");
+}
+
 inline u64 get_cr2() {
 	u64 value;
 	asm("movq %%cr2, %0" : "=r"(value));
@@ -37,8 +46,126 @@ inline u64 get_cr3() {
 	return value;
 }
 
+inline void set_cr3(u64 value) {
+	asm volatile("movq %0, %%cr3" : : "r"(value) : "memory");
+}
+
 inline u64 get_cr4() {
 	u64 value;
 	asm("movq %%cr4, %0" : "=r"(value));
 	return value;
-}
\ No newline at end of file
+}
+
+inline void set_cr4(u64 value) {
+	asm volatile("movq %0, %%cr4" : : "r"(value) : "memory");
+}
+
+inline u64 rdmsr(u32 msr) {
+	u32 low, high;
+	asm volatile("rdmsr" : "=a"(low), "=d"(high) : "c"(msr));
+	return (u64(high) << 32) | low;
+}
+
+inline void wrmsr(u32 msr, u64 value) {
+	asm volatile("wrmsr" : : "c"(msr), "a"(u32(value)), "d"(u32(value >> 32)) : "memory");
+}
+
+struct CPUIDResult {
+	u32 eax, ebx, ecx, edx;
+};
+
+inline CPUIDResult cpuid(u32 leaf, u32 subleaf = 0) {
+	CPUIDResult result;
+	asm volatile("cpuid"
+		: "=a"(result.eax), "=b"(result.ebx), "=c"(result.ecx), "=d"(result.edx)
+		: "a"(leaf), "c"(subleaf));
+	return result;
+}
+
+inline u64 rdtsc() {
+	u32 low, high;
+	asm volatile("rdtsc" : "=a"(low), "=d"(high));
+	return (u64(high) << 32) | low;
+}
+
+// interrupt enable flag in rflags
+static constexpr u64 RFLAGS_IF = 1 << 9;
+
+#ifdef TRACE_IRQS_OFF
+namespace kernel::irq_trace {
+void irqs_off(const char* file, u32 line);
+void irqs_on(const char* file, u32 line);
+void preempt_off(const char* file, u32 line);
+void preempt_on(const char* file, u32 line);
+}
+#endif
+
+inline u64 get_rflags() {
+	u64 flags;
+	asm volatile("pushfq; popq %0" : "=r"(flags));
+	return flags;
+}
+
+inline bool interrupts_enabled() {
+	return get_rflags() & RFLAGS_IF;
+}
+
+// Tells the interrupts-off tracer that interrupts just got disabled, for
+// places that don't go through the helpers below (such as IRQ entry).
+inline void trace_irqs_off([[maybe_unused]] const char* file = __builtin_FILE(), [[maybe_unused]] u32 line = __builtin_LINE()) {
+#ifdef TRACE_IRQS_OFF
+	kernel::irq_trace::irqs_off(file, line);
+#endif
+}
+
+// Tells the interrupts-off tracer that interrupts are about to be enabled.
+inline void trace_irqs_on([[maybe_unused]] const char* file = __builtin_FILE(), [[maybe_unused]] u32 line = __builtin_LINE()) {
+#ifdef TRACE_IRQS_OFF
+	kernel::irq_trace::irqs_on(file, line);
+#endif
+}
+
+// Tells the tracer that preemption just got disabled, `preempt_disable` calls this
+// when the count goes from 0 to 1.
+inline void trace_preempt_off([[maybe_unused]] const char* file = __builtin_FILE(), [[maybe_unused]] u32 line = __builtin_LINE()) {
+#ifdef TRACE_IRQS_OFF
+	kernel::irq_trace::preempt_off(file, line);
+#endif
+}
+
+// Tells the tracer that preemption is about to be enabled again.
+inline void trace_preempt_on([[maybe_unused]] const char* file = __builtin_FILE(), [[maybe_unused]] u32 line = __builtin_LINE()) {
+#ifdef TRACE_IRQS_OFF
+	kernel::irq_trace::preempt_on(file, line);
+#endif
+}
+
+// The helpers below take the caller's location, so the tracer
+// can tell who disabled interrupts and who enabled them again.
+
+inline void cli(const char* file = __builtin_FILE(), u32 line = __builtin_LINE()) {
+	asm volatile("cli" : : : "memory");
+	trace_irqs_off(file, line);
+}
+
+inline void sti(const char* file = __builtin_FILE(), u32 line = __builtin_LINE()) {
+	trace_irqs_on(file, line);
+	asm volatile("sti" : : : "memory");
+}
+
+// Disables interrupts, returning the previous flags to be given to `irq_restore`.
+inline u64 irq_save(const char* file = __builtin_FILE(), u32 line = __builtin_LINE()) {
+	u64 flags;
+	asm volatile("pushfq; popq %0; cli" : "=r"(flags) : : "memory");
+	if (flags & RFLAGS_IF) {
+		trace_irqs_off(file, line);
+	}
+	return flags;
+}
+
+// Re-enables interrupts only if they were enabled when `irq_save` was called.
+inline void irq_restore(u64 flags, const char* file = __builtin_FILE(), u32 line = __builtin_LINE()) {
+	if (flags & RFLAGS_IF) {
+		sti(file, line);
+	}
+}
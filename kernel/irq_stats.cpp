@@ -0,0 +1,66 @@
+#include <kernel/irq_stats.hpp>
+#include <kernel/cpu.hpp>
+#include <kernel/time/time.hpp>
+#include <kernel/log.hpp>
+#include <kernel/intrinsics.hpp>
+
+using namespace kernel;
+using namespace kernel::irq_stats;
+
+void kernel::irq_stats::record(u8 vector, u64 cycles) {
+	auto& stats = this_cpu()->irq_stats[vector];
+	stats.count++;
+	stats.total_cycles += cycles;
+	if (cycles > stats.max_cycles) {
+		stats.max_cycles = cycles;
+	}
+
+	usize bucket = 63 - __builtin_clzll(cycles | 1);
+	if (bucket >= HISTOGRAM_BUCKETS) {
+		bucket = HISTOGRAM_BUCKETS - 1;
+	}
+	stats.histogram[bucket]++;
+}
+
+const VectorStats& kernel::irq_stats::get(u8 vector) {
+	return this_cpu()->irq_stats[vector];
+}
+
+void kernel::irq_stats::dump() {
+	// copied out first, so interrupts don't stay off while slowly writing to serial.
+	// other CPUs keep going while this reads their stats, so those may be slightly torn
+	VectorStats stats;
+
+	kdbgln("[irq stats] vector: count, total, avg, max");
+	for (usize id = 0; id < cpu::count(); ++id) {
+		const auto* cpu = cpu::get(id);
+		if (!cpu->online) continue;
+
+		kdbgln("[irq stats] cpu {}", id);
+		for (usize vector = 0; vector < 256; ++vector) {
+			const auto flags = irq_save();
+			stats = cpu->irq_stats[vector];
+			irq_restore(flags);
+
+			if (!stats.count) continue;
+
+			kdbgln("[irq stats] {:#x}: {}, {}ns, {}ns, {}ns", vector, stats.count,
+				time::cycles_to_ns(stats.total_cycles),
+				time::cycles_to_ns(stats.total_cycles / stats.count),
+				time::cycles_to_ns(stats.max_cycles));
+
+			for (usize bucket = 0; bucket < HISTOGRAM_BUCKETS; ++bucket) {
+				if (!stats.histogram[bucket]) continue;
+				kdbgln("[irq stats]   >= {}ns: {}", time::cycles_to_ns(u64(1) << bucket), stats.histogram[bucket]);
+			}
+		}
+	}
+}
+
+void kernel::irq_stats::reset() {
+	const auto flags = irq_save();
+	for (auto& stats : this_cpu()->irq_stats) {
+		stats = VectorStats();
+	}
+	irq_restore(flags);
+}
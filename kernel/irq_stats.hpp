@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stl/types.hpp>
+
+namespace kernel::irq_stats {
+
+// handler times get bucketed by log2 of their TSC cycles,
+// so bucket i counts handlers that took [2^i, 2^(i+1)) cycles
+static constexpr usize HISTOGRAM_BUCKETS = 32;
+
+struct VectorStats {
+	u64 count = 0;
+	u64 total_cycles = 0;
+	u64 max_cycles = 0;
+	u32 histogram[HISTOGRAM_BUCKETS] = {};
+};
+
+// Records one handled interrupt on `vector` that took `cycles` TSC cycles.
+// Called from the interrupt dispatcher, with interrupts disabled.
+void record(u8 vector, u64 cycles);
+
+// Stats for a vector on this CPU.
+const VectorStats& get(u8 vector);
+
+// Prints the stats for every vector that had any interrupts over serial, for every CPU.
+void dump();
+
+// Clears the stats of this CPU.
+void reset();
+
+}
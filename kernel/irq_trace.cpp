@@ -0,0 +1,181 @@
+#include <stl/string.hpp>
+#include <kernel/irq_trace.hpp>
+#include <kernel/cpu.hpp>
+#include <kernel/time/time.hpp>
+#include <kernel/log.hpp>
+#include <kernel/intrinsics.hpp>
+
+using namespace kernel;
+using kernel::irq_trace::OpenWindow;
+
+struct Location {
+	const char* file = nullptr;
+	u32 line = 0;
+
+	bool operator==(const Location& other) const {
+		if (line != other.line) return false;
+		// the same file can end up as different strings in different translation units
+		return file == other.file || mat::StringView(file) == mat::StringView(other.file);
+	}
+};
+
+struct Window {
+	Location off;
+	Location on;
+	u64 count = 0;
+	u64 total_cycles = 0;
+	u64 max_cycles = 0;
+};
+
+static constexpr usize MAX_WINDOWS = 32;
+static constexpr usize REPORT_WINDOWS = 10;
+
+// distinct off -> on location pairs from every CPU, once full the shortest gets replaced
+struct Trace {
+	const char* name = nullptr;
+	Window windows[MAX_WINDOWS] = {};
+	usize window_count = 0;
+	// not a SpinLock, that would disable preemption and end up tracing itself
+	bool locked = false;
+};
+
+static Trace irqs_off_trace { .name = "irqs off" };
+static Trace preempt_off_trace { .name = "preempt off" };
+
+// Takes the lock of `trace` with interrupts disabled, so an interrupt on this CPU can't
+// try to take it again. Not through irq_save either, for the same reason as above.
+static u64 lock(Trace& trace) {
+	u64 flags;
+	asm volatile("pushfq; popq %0; cli" : "=r"(flags) : : "memory");
+	while (__atomic_exchange_n(&trace.locked, true, __ATOMIC_ACQUIRE)) {
+		cpu_relax();
+	}
+	return flags;
+}
+
+static void unlock(Trace& trace, u64 flags) {
+	__atomic_store_n(&trace.locked, false, __ATOMIC_RELEASE);
+	if (flags & RFLAGS_IF) {
+		asm volatile("sti" : : : "memory");
+	}
+}
+
+// must be called with the lock of `trace` held
+static void record(Trace& trace, const Location& disabled_by, const Location& enabled_by, u64 cycles) {
+	Window* shortest = nullptr;
+	for (usize i = 0; i < trace.window_count; ++i) {
+		auto& window = trace.windows[i];
+		if (window.off == disabled_by && window.on == enabled_by) {
+			window.count++;
+			window.total_cycles += cycles;
+			if (cycles > window.max_cycles) {
+				window.max_cycles = cycles;
+			}
+			return;
+		}
+		if (!shortest || window.max_cycles < shortest->max_cycles) {
+			shortest = &window;
+		}
+	}
+
+	Window* slot = nullptr;
+	if (trace.window_count < MAX_WINDOWS) {
+		slot = &trace.windows[trace.window_count++];
+	} else if (cycles > shortest->max_cycles) {
+		slot = shortest;
+	} else {
+		return;
+	}
+	*slot = Window { disabled_by, enabled_by, 1, cycles, cycles };
+}
+
+static void open_window(OpenWindow& open, const char* file, u32 line) {
+	// nested, such as an exception with interrupts already disabled
+	if (open.active) return;
+
+	open.active = true;
+	open.file = file;
+	open.line = line;
+	open.since = rdtsc();
+}
+
+static void close_window(Trace& trace, OpenWindow& open, const char* file, u32 line) {
+	if (!open.active) return;
+
+	const auto cycles = rdtsc() - open.since;
+	open.active = false;
+	const Location disabled_by { open.file, open.line };
+	const Location enabled_by { file, line };
+
+	const auto flags = lock(trace);
+	record(trace, disabled_by, enabled_by, cycles);
+	unlock(trace, flags);
+}
+
+void kernel::irq_trace::irqs_off(const char* file, u32 line) {
+	open_window(this_cpu()->irq_trace.irqs, file, line);
+}
+
+void kernel::irq_trace::irqs_on(const char* file, u32 line) {
+	close_window(irqs_off_trace, this_cpu()->irq_trace.irqs, file, line);
+}
+
+// these are called with preemption disabled, so this_cpu stays the same
+
+void kernel::irq_trace::preempt_off(const char* file, u32 line) {
+	open_window(this_cpu()->irq_trace.preempt, file, line);
+}
+
+void kernel::irq_trace::preempt_on(const char* file, u32 line) {
+	close_window(preempt_off_trace, this_cpu()->irq_trace.preempt, file, line);
+}
+
+static void report_trace(Trace& trace) {
+	// copied out first, so the report itself doesn't show up as the worst offender
+	Window sorted[MAX_WINDOWS];
+	const auto flags = lock(trace);
+	const auto count = trace.window_count;
+	for (usize i = 0; i < count; ++i) {
+		sorted[i] = trace.windows[i];
+	}
+	unlock(trace, flags);
+
+	// insertion sort, longest first
+	for (usize i = 1; i < count; ++i) {
+		for (usize j = i; j > 0 && sorted[j].max_cycles > sorted[j - 1].max_cycles; --j) {
+			const auto tmp = sorted[j];
+			sorted[j] = sorted[j - 1];
+			sorted[j - 1] = tmp;
+		}
+	}
+
+	kdbgln("[{}] max, avg, count: disabled at -> enabled at", trace.name);
+	for (usize i = 0; i < count && i < REPORT_WINDOWS; ++i) {
+		const auto& window = sorted[i];
+		kdbgln("[{}] {}ns, {}ns, {}: {}:{} -> {}:{}", trace.name,
+			time::cycles_to_ns(window.max_cycles),
+			time::cycles_to_ns(window.total_cycles / window.count),
+			window.count,
+			window.off.file, window.off.line,
+			window.on.file, window.on.line);
+	}
+}
+
+void kernel::irq_trace::report() {
+#ifndef TRACE_IRQS_OFF
+	kdbgln("[irqs off] tracing is disabled, build with -DTRACE_IRQS_OFF=ON");
+#endif
+	report_trace(irqs_off_trace);
+	report_trace(preempt_off_trace);
+}
+
+static void reset_trace(Trace& trace) {
+	const auto flags = lock(trace);
+	trace.window_count = 0;
+	unlock(trace, flags);
+}
+
+void kernel::irq_trace::reset() {
+	reset_trace(irqs_off_trace);
+	reset_trace(preempt_off_trace);
+}
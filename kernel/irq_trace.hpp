@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stl/types.hpp>
+
+// Interrupts-off and preemption-off tracer. When built with TRACE_IRQS_OFF, every transition
+// through the helpers in intrinsics.hpp and of the preemption count gets timestamped, and the
+// longest windows with interrupts or preemption disabled are kept along with where they were
+// opened and closed.
+namespace kernel::irq_trace {
+
+struct OpenWindow {
+	bool active = false;
+	u64 since = 0;
+	const char* file = nullptr;
+	u32 line = 0;
+};
+
+// The windows currently open on a CPU, part of the per-CPU data.
+struct CPUState {
+	OpenWindow irqs;
+	OpenWindow preempt;
+};
+
+// Called whenever interrupts get disabled or enabled, with interrupts disabled.
+// These are what the intrinsics.hpp helpers call, there's no need to call them directly.
+void irqs_off(const char* file, u32 line);
+void irqs_on(const char* file, u32 line);
+
+// Called when the preemption count goes from 0 to 1 and back, with preemption disabled.
+void preempt_off(const char* file, u32 line);
+void preempt_on(const char* file, u32 line);
+
+// Prints the worst offenders over serial, longest first.
+void report();
+
+// Clears everything recorded so far.
+void reset();
+
+}
@@ -1,37 +1,85 @@
 #include <kernel/intrinsics.hpp>
 #include <kernel/serial.hpp>
 #include <kernel/idt.hpp>
+#include <kernel/cpu.hpp>
+#include <kernel/features.hpp>
+#include <kernel/dispatch.hpp>
+#include <kernel/alternatives.hpp>
+#include <kernel/fpu.hpp>
+#include <kernel/smp.hpp>
+#include <kernel/idle.hpp>
+#include <kernel/sched/scheduler.hpp>
+#include <kernel/async/executor.hpp>
+#include <kernel/sync/rcu.hpp>
+#include <kernel/bench/bench.hpp>
+#include <kernel/acpi.hpp>
 #include <kernel/log.hpp>
 #include <kernel/memory/allocator.hpp>
 #include <kernel/memory/paging.hpp>
+#include <kernel/memory/tlb.hpp>
 #include <kernel/device/pic.hpp>
+#include <kernel/device/apic.hpp>
 #include <kernel/device/ps2.hpp>
 #include <kernel/device/pit.hpp>
+#include <kernel/device/lapic_timer.hpp>
+#include <kernel/device/hpet.hpp>
+#include <kernel/time/time.hpp>
+#include <kernel/input/input.hpp>
 #include <kernel/screen/framebuffer.hpp>
+#include <kernel/screen/terminal.hpp>
 
 using namespace kernel;
 
 extern "C" void kernel_init() {
+	// everything else may need the per-CPU data
+	cpu::init_bsp();
+
 	serial::init();
 
 	kdbgln("Booting up...");
 
+	features::init();
+	alternatives::init();
+	fpu::init();
+	dispatch::init();
+
 	idt::init();
 
 	paging::init();
 
 	alloc::init();
 
+	acpi::init();
+
 	pic::init();
-	ps2::init();
+	pic::disable();
+	apic::init();
+
 	pit::init();
+	time::init();
+	hpet::init_clock_event();
+	lapic_timer::init();
+
+	tlb::init();
+	idle::init();
+	smp::init();
+
+	ps2::init();
 
 	framebuffer::init();
 
-	kdbgln("Finished initialization, halting");
+	sched::init();
+	async::init();
+	rcu::init();
+	input::init();
+	terminal::init();
+
+#ifdef KERNEL_BENCHMARKS
+	sched::spawn("benchmarks", [](void*) { bench::run_all(); });
+#endif
+
+	kdbgln("Finished initialization");
 
-	// halt without disabling interrupts
-	while (true) {
-		asm volatile("hlt");
-	}
+	// the boot stack lives on as this CPU's idle thread
+	sched::idle();
 }
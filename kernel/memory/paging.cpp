@@ -5,6 +5,8 @@
 #include <stl/memory.hpp>
 #include <kernel/memory/allocator.hpp>
 #include <kernel/memory/paging.hpp>
+#include <kernel/memory/tlb.hpp>
+#include <kernel/alternatives.hpp>
 #include <kernel/log.hpp>
 #include <kernel/intrinsics.hpp>
 
@@ -118,11 +120,15 @@ void kernel::paging::map_page(VirtualAddress virt, PhysicalAddress phys) {
 	const auto index_pd = virt.value() >> 21 & mask9;
 	const auto index_pt = virt.value() >> 12 & mask9;
 
+	// a present entry may be cached in some TLB, but a non present one never is
+	bool was_present = false;
+
 	// allocates a page table if its not present
-	static constexpr auto allocate_entry_and_follow = [](PageTableEntry& entry) {
+	static constexpr auto allocate_entry_and_follow = [](PageTableEntry& entry, bool& was_present) {
 		// check if this is a big page too, in which case we create a new
 		// table anyways, since we only care about 4 kib pages
 		if (!entry.is_present() || entry.is_ps()) {
+			was_present = was_present || entry.is_present();
 			entry.set_available(MAT_TABLE_MAGIC);
 			entry.set_present(true);
 			entry.set_writable(true);
@@ -131,7 +137,7 @@ void kernel::paging::map_page(VirtualAddress virt, PhysicalAddress phys) {
 			entry.set_execution_disabled(false);
 
 			auto page = kernel::alloc::allocate_physical_page();
-			mat::memset(page.to_virtual().ptr(), 0, PAGE_SIZE);
+			clear_page(page.to_virtual());
 			
 			entry.set_addr(page);
 		}
@@ -139,9 +145,10 @@ void kernel::paging::map_page(VirtualAddress virt, PhysicalAddress phys) {
 	};
 
 	auto& entry_pml4 = entries[index_pml4];
-	auto& entry_pdp = allocate_entry_and_follow(entry_pml4)[index_pdp];
-	auto& entry_pd = allocate_entry_and_follow(entry_pdp)[index_pd];
-	auto& entry = allocate_entry_and_follow(entry_pd)[index_pt];
+	auto& entry_pdp = allocate_entry_and_follow(entry_pml4, was_present)[index_pdp];
+	auto& entry_pd = allocate_entry_and_follow(entry_pdp, was_present)[index_pd];
+	auto& entry = allocate_entry_and_follow(entry_pd, was_present)[index_pt];
+	was_present = was_present || entry.is_present();
 
 	if (entry.is_present() && entry.get_available() == MAT_MAPPED_MAGIC) {
 		panic("Tried to map to address that was already mapped! ({:#x} trying to {:#x}, but is {:#x})",
@@ -155,10 +162,17 @@ void kernel::paging::map_page(VirtualAddress virt, PhysicalAddress phys) {
 	entry.set_execution_disabled(false);
 	entry.set_addr(phys);
 
-	invalidate_cache(virt);
+	if (was_present) {
+		tlb::flush_page(virt);
+	}
 }
 
 void kernel::paging::unmap_page(VirtualAddress virt) {
+	tlb::FlushBatch batch;
+	unmap_page(virt, batch);
+}
+
+void kernel::paging::unmap_page(VirtualAddress virt, tlb::FlushBatch& batch) {
 	auto* entries = get_base_entries();
 
 	static constexpr auto mask9 = bit_mask<u64>(9);
@@ -189,12 +203,27 @@ void kernel::paging::unmap_page(VirtualAddress virt) {
 	}
 
 	entry.clear();
-	invalidate_cache(virt);
+	batch.add(virt);
 
 	kdbgln("entry is now {}", entry);
 }
 
+void kernel::paging::unmap_pages(VirtualAddress virt, usize count) {
+	tlb::FlushBatch batch;
+	for (usize i = 0; i < count; ++i) {
+		unmap_page(virt + i * PAGE_SIZE, batch);
+	}
+}
+
+void kernel::paging::clear_page(VirtualAddress page) {
+	// with ERMS a single rep stosb is the fastest way, the microcode picks the store size itself
+	auto* ptr = page.ptr();
+	asm volatile(ALTERNATIVE("movl $512, %%ecx; rep stosq", "movl $4096, %%ecx; rep stosb")
+		: "+D"(ptr)
+		: "a"(0), ALTERNATIVE_FEATURE(features::Feature::ERMS)
+		: "rcx", "memory");
+}
+
 void kernel::paging::invalidate_cache(VirtualAddress virt) {
-	const auto value = virt.value();
-	asm volatile("invlpg %0" : : "m"(value));
+	tlb::flush_local_page(virt);
 }
\ No newline at end of file
@@ -41,6 +41,10 @@ public:
 	VirtualAddress operator+(uptr offset) const;
 };
 
+namespace tlb {
+class FlushBatch;
+}
+
 namespace paging {
 
 class PageTableEntry {
@@ -103,10 +107,20 @@ void explore_addr(uptr value);
 // TODO: add flags, and maybe page size
 void map_page(VirtualAddress virt, PhysicalAddress phys);
 
-// Unmaps a page, making it not present.
+// Unmaps a page, making it not present, and flushes it out of every CPU's TLB.
 void unmap_page(VirtualAddress virt);
 
-// Invalidates the TLB cache for a certain page.
+// Unmaps a page, leaving the TLB flush to `batch`.
+void unmap_page(VirtualAddress virt, tlb::FlushBatch& batch);
+
+// Unmaps `count` contiguous pages, with a single TLB shootdown for all of them.
+void unmap_pages(VirtualAddress virt, usize count);
+
+// Zeroes a whole page, with whatever clears pages fastest on this CPU.
+void clear_page(VirtualAddress page);
+
+// Invalidates the TLB cache for a certain page, on the calling CPU only.
+// Use the functions in tlb.hpp when other CPUs may have it cached too.
 void invalidate_cache(VirtualAddress virt);
 
 }
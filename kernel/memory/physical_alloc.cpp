@@ -3,6 +3,7 @@
 #include <stl/math.hpp>
 #include <kernel/memory/allocator.hpp>
 #include <kernel/memory/paging.hpp>
+#include <kernel/dispatch.hpp>
 #include <kernel/intrinsics.hpp>
 #include <kernel/log.hpp>
 
@@ -32,10 +33,17 @@ public:
 	bool get(usize index) const {
 		const auto array_index = index / bits_per_element;
 		const auto bit_index = index % bits_per_element;
-		const ElementType bit_mask = 1 << bit_index;
+		const ElementType bit_mask = ElementType(1) << bit_index;
 		return m_data[array_index] & bit_mask;
 	}
 
+	// Index of the first unset bit, or `size()` if they're all set.
+	usize find_first_zero() const {
+		return kernel::dispatch::find_first_zero(m_data.data(), m_data.size());
+	}
+
+	usize size() const { return m_data.size() * bits_per_element; }
+
 	void clear() {
 		for (auto& value : m_data) {
 			value = 0;
@@ -117,27 +125,31 @@ void kernel::alloc::init() {
 	kdbgln("The bitmap array occupies {} KiB of space", bitmap_array_size / 1024);
 }
 
-// both of these implementations are incredibly inefficient, but they should at least work
+// both of these still walk the memory map to turn bitmap indices into addresses and back
 
 kernel::PhysicalAddress kernel::alloc::allocate_physical_page() {
-	usize page_index = 0;
+	// scanning a whole u64 of the bitmap at a time
+	const auto page_index = bitmap.find_first_zero();
+	if (page_index >= bitmap.size()) {
+		panic("Couldn't allocate a single page");
+	}
+
+	// then find which usable region that page is in. pages are numbered through
+	// the usable regions in order, skipping any partial page at the end of each
 	uptr page_address = 0;
+	usize first_index = 0;
 	for (usize i = 0; i < memmap_request.response->entry_count; ++i) {
 		auto* entry = memmap_request.response->entries[i];
-		if (entry->type == LIMINE_MEMMAP_USABLE) {
-			// start with size = PAGE_SIZE because we want to skip regions
-			// smaller than the page size. so size ends up being the end of the page
-			for (auto size = PAGE_SIZE; size <= entry->length; size += PAGE_SIZE) {
-				if (!bitmap.get(page_index)) {
-					page_address = entry->base + size - PAGE_SIZE;
-					break;
-				}
-				page_index++;
-			}
-			if (page_address) break;
+		if (entry->type != LIMINE_MEMMAP_USABLE) continue;
+
+		const auto pages = entry->length / PAGE_SIZE;
+		if (page_index < first_index + pages) {
+			page_address = entry->base + (page_index - first_index) * PAGE_SIZE;
+			break;
 		}
+		first_index += pages;
 	}
-	
+
 	if (!page_address) {
 		panic("Couldn't allocate a single page");
 	}
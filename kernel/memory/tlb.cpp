@@ -0,0 +1,175 @@
+#include <kernel/memory/tlb.hpp>
+#include <kernel/cpu.hpp>
+#include <kernel/idt.hpp>
+#include <kernel/device/apic.hpp>
+#include <kernel/sync/spinlock.hpp>
+#include <kernel/time/time.hpp>
+#include <kernel/alternatives.hpp>
+#include <kernel/log.hpp>
+#include <kernel/intrinsics.hpp>
+
+using namespace kernel;
+using namespace kernel::tlb;
+
+static constexpr u64 CR4_PGE = 1 << 7;
+
+// CPUs that have the kernel address space loaded, indexed by CPU id.
+// there is only the one address space for now, so this is every CPU that's up
+static u64 active_cpus = 0;
+
+// The shootdown currently in flight. Only one at a time, whoever wants to send
+// another has to wait for every target to be done with this one.
+struct Request {
+	uptr pages[MAX_BATCH_PAGES] = {};
+	usize count = 0;
+	bool full = false;
+	// CPUs that haven't handled it yet
+	u64 pending = 0;
+};
+
+static Request request;
+static sync::SpinLock request_lock;
+
+void kernel::tlb::flush_local_page(VirtualAddress page) {
+	asm volatile("invlpg (%0)" : : "r"(page.value()) : "memory");
+}
+
+void kernel::tlb::flush_local_all() {
+	if (alternatives::static_has(features::Feature::INVPCID)) {
+		// type 2 drops every translation, global ones included, without touching CR4.
+		// the descriptor is ignored for this type, but still has to be readable
+		static constexpr u64 descriptor[2] = {};
+		asm volatile("invpcid %0, %1" : : "m"(descriptor), "r"(u64(2)) : "memory");
+		return;
+	}
+
+	const auto cr4 = get_cr4();
+	if (cr4 & CR4_PGE) {
+		// toggling PGE is the only way to get rid of global pages too
+		asm volatile("movq %0, %%cr4; movq %1, %%cr4" : : "r"(cr4 & ~CR4_PGE), "r"(cr4) : "memory");
+	} else {
+		set_cr3(get_cr3());
+	}
+}
+
+static void flush_local(const uptr* pages, usize count, bool full) {
+	if (full) {
+		flush_local_all();
+		return;
+	}
+	for (usize i = 0; i < count; ++i) {
+		flush_local_page(VirtualAddress(pages[i]));
+	}
+}
+
+static void handle_shootdown() {
+	auto* cpu = this_cpu();
+	flush_local(request.pages, request.count, request.full);
+	cpu->tlb_stats.received++;
+	// the sender is spinning on this, and may reuse the request as soon as it's clear
+	__atomic_fetch_and(&request.pending, ~(u64(1) << cpu->id), __ATOMIC_RELEASE);
+	apic::send_eoi();
+}
+
+static void shootdown(const uptr* pages, usize count, bool full) {
+	// everything from the local flush to working out the targets has to happen on the same
+	// CPU, otherwise the one this moved away from would be left out
+	sched::preempt_disable();
+	const auto start = rdtsc();
+	auto* cpu = this_cpu();
+	auto& stats = cpu->tlb_stats;
+
+	flush_local(pages, count, full);
+
+	const auto targets = __atomic_load_n(&active_cpus, __ATOMIC_ACQUIRE) & ~(u64(1) << cpu->id);
+	if (!targets) {
+		sched::preempt_enable();
+		return;
+	}
+
+	// another CPU could be spinning on the lock with a shootdown of its own for us,
+	// which we'd never get to handle
+	if (!interrupts_enabled()) {
+		panic("Tried to do a TLB shootdown with interrupts disabled");
+	}
+
+	request_lock.lock();
+	for (usize i = 0; i < count; ++i) {
+		request.pages[i] = pages[i];
+	}
+	request.count = count;
+	request.full = full;
+	__atomic_store_n(&request.pending, targets, __ATOMIC_RELEASE);
+
+	for (u32 id = 0; id < MAX_CPUS; ++id) {
+		if (!(targets & (u64(1) << id))) continue;
+		apic::send_ipi(cpu::get(id)->lapic_id, TLB_SHOOTDOWN_VECTOR);
+		stats.ipis_sent++;
+	}
+
+	while (__atomic_load_n(&request.pending, __ATOMIC_ACQUIRE)) {
+		cpu_relax();
+	}
+	request_lock.unlock();
+
+	const auto cycles = rdtsc() - start;
+	stats.shootdowns++;
+	stats.pages += count;
+	if (full) stats.full_flushes++;
+	stats.total_cycles += cycles;
+	if (cycles > stats.max_cycles) {
+		stats.max_cycles = cycles;
+	}
+	sched::preempt_enable();
+}
+
+void FlushBatch::add(VirtualAddress page) {
+	if (m_full) return;
+	if (m_count == MAX_BATCH_PAGES) {
+		m_full = true;
+		return;
+	}
+	m_pages[m_count++] = page.value();
+}
+
+void FlushBatch::flush() {
+	if (!m_count && !m_full) return;
+	shootdown(m_pages, m_count, m_full);
+	m_count = 0;
+	m_full = false;
+}
+
+void kernel::tlb::flush_page(VirtualAddress page) {
+	const auto value = page.value();
+	shootdown(&value, 1, false);
+}
+
+void kernel::tlb::flush_all() {
+	shootdown(nullptr, 0, true);
+}
+
+void kernel::tlb::activate() {
+	__atomic_fetch_or(&active_cpus, u64(1) << this_cpu()->id, __ATOMIC_RELEASE);
+}
+
+void kernel::tlb::init() {
+	idt::set_irq_handler(TLB_SHOOTDOWN_VECTOR, &handle_shootdown);
+	activate();
+
+	kdbgln("TLB shootdown initialized");
+}
+
+void kernel::tlb::dump_stats() {
+	kdbgln("[tlb] shootdowns, ipis, pages, full flushes, avg, max, received");
+	for (usize id = 0; id < cpu::count(); ++id) {
+		const auto* cpu = cpu::get(id);
+		if (!cpu->online) continue;
+
+		const auto& stats = cpu->tlb_stats;
+		kdbgln("[tlb] cpu {}: {}, {}, {}, {}, {}ns, {}ns, {}", id,
+			stats.shootdowns, stats.ipis_sent, stats.pages, stats.full_flushes,
+			stats.shootdowns ? time::cycles_to_ns(stats.total_cycles / stats.shootdowns) : 0,
+			time::cycles_to_ns(stats.max_cycles),
+			stats.received);
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stl/types.hpp>
+#include <kernel/memory/paging.hpp>
+
+namespace kernel::tlb {
+
+// Flushing more pages than this at once just flushes everything instead,
+// which is cheaper than going through them one invlpg at a time.
+static constexpr usize MAX_BATCH_PAGES = 32;
+
+// Gathers up page invalidations, so that other CPUs only get interrupted once for all of them.
+// Flushes whatever is left when it goes out of scope.
+class FlushBatch {
+	uptr m_pages[MAX_BATCH_PAGES];
+	usize m_count = 0;
+	bool m_full = false;
+
+public:
+	FlushBatch() = default;
+	FlushBatch(const FlushBatch&) = delete;
+	~FlushBatch() { flush(); }
+
+	void add(VirtualAddress page);
+
+	// Invalidates everything added so far on every CPU using the address space.
+	void flush();
+};
+
+// Counters for the shootdowns sent and received by a CPU, part of the per-CPU data.
+struct CPUStats {
+	// shootdowns this CPU started, and the IPIs it took
+	u64 shootdowns = 0;
+	u64 ipis_sent = 0;
+	u64 pages = 0;
+	u64 full_flushes = 0;
+	// from starting a shootdown until every other CPU is done with it
+	u64 total_cycles = 0;
+	u64 max_cycles = 0;
+	// shootdown IPIs handled by this CPU
+	u64 received = 0;
+};
+
+// Registers the shootdown IPI handler, and marks the bootstrap CPU as using the kernel address space.
+void init();
+
+// Marks the calling CPU as using the kernel address space, so it gets shootdowns from now on.
+void activate();
+
+// Invalidates a single page on every CPU using the address space.
+void flush_page(VirtualAddress page);
+
+// Invalidates the whole TLB of every CPU using the address space.
+void flush_all();
+
+// Invalidates a page on the calling CPU only.
+void flush_local_page(VirtualAddress page);
+
+// Invalidates the whole TLB of the calling CPU only, including global pages.
+void flush_local_all();
+
+// Prints the shootdown counters of every CPU over serial.
+void dump_stats();
+
+}
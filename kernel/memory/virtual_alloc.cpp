@@ -1,5 +1,6 @@
 #include <kernel/memory/allocator.hpp>
 #include <kernel/memory/paging.hpp>
+#include <kernel/sync/spinlock.hpp>
 #include <kernel/log.hpp>
 
 // start virtual allocations at 4 MiB, why not :-)
@@ -8,11 +9,16 @@ static constexpr uptr BASE_ADDRESS = 4 * 1024 * 1024;
 // implement a simple bump allocator for now
 usize allocated_pages = 0;
 
+// guards the bump allocator, and with it the physical allocator and page tables underneath.
+// mapping may need a TLB shootdown, so this must not be taken with interrupts disabled
+static kernel::sync::SpinLock alloc_lock;
+
 void* kernel::alloc::allocate_page() {
 	return allocate_pages(1);
 }
 
 void* kernel::alloc::allocate_pages(usize count) {
+	alloc_lock.lock();
 	const auto addr = VirtualAddress(BASE_ADDRESS) + (allocated_pages * PAGE_SIZE);
 	allocated_pages += count;
 
@@ -20,6 +26,7 @@ void* kernel::alloc::allocate_pages(usize count) {
 		const auto page = allocate_physical_page();
 		paging::map_page(addr + i * PAGE_SIZE, page);
 	}
+	alloc_lock.unlock();
 
 	return addr.ptr();
 }
@@ -29,6 +36,7 @@ void kernel::alloc::free_page(void* addr) {
 	if (value < BASE_ADDRESS || !allocated_pages) {
 		panic("Tried to free invalid address ({})", addr);
 	}
+	alloc_lock.lock();
 	if (value == BASE_ADDRESS + (allocated_pages - 1) * PAGE_SIZE) {
 		kdbgln("Freeing top most page");
 		allocated_pages--;
@@ -36,4 +44,5 @@ void kernel::alloc::free_page(void* addr) {
 	} else {
 		kdbgln("hehe sorry cant free");
 	}
+	alloc_lock.unlock();
 }
\ No newline at end of file
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stl/types.hpp>
+
+// Kept apart from the scheduler header so that the locks (and everything else the
+// per-CPU data is made of) can use these without an include cycle.
+namespace kernel::sched {
+
+// Disables preemption on this CPU, nests. The location is for the preemption-off tracer.
+void preempt_disable(const char* file = __builtin_FILE(), u32 line = __builtin_LINE());
+
+// Re-enables preemption, switching threads right away if one was due in the meantime.
+void preempt_enable(const char* file = __builtin_FILE(), u32 line = __builtin_LINE());
+
+}
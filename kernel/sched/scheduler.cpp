@@ -0,0 +1,820 @@
+#include <stl/memory.hpp>
+#include <kernel/sched/scheduler.hpp>
+#include <kernel/sync/spinlock.hpp>
+#include <kernel/sync/rcu.hpp>
+#include <kernel/memory/allocator.hpp>
+#include <kernel/device/apic.hpp>
+#include <kernel/time/clock_event.hpp>
+#include <kernel/time/time.hpp>
+#include <kernel/cpu.hpp>
+#include <kernel/idle.hpp>
+#include <kernel/idt.hpp>
+#include <kernel/log.hpp>
+#include <kernel/intrinsics.hpp>
+
+using namespace kernel;
+using namespace kernel::sched;
+
+// exited threads, kept around to reuse their stacks
+static Thread* free_threads = nullptr;
+static u32 next_thread_id = 1;
+// guards the two above. the run queues are per CPU, each with its own lock
+static sync::SpinLock threads_lock;
+
+// bandwidth is kept in fixed point, as a fraction of 2^20
+static constexpr u32 BANDWIDTH_SHIFT = 20;
+static constexpr u64 MAX_BANDWIDTH = (u64(1) << BANDWIDTH_SHIFT) * DEADLINE_MAX_PERCENT / 100;
+// guards the deadline bandwidth of every CPU
+static sync::SpinLock admission_lock;
+
+// Saves the callee saved registers on the current stack, stores the stack pointer
+// into `old_rsp` and switches to `new_rsp`, popping the registers saved there.
+// Everything else has already been saved by the caller, as per the calling convention.
+[[gnu::naked]] static void switch_context([[maybe_unused]] u64* old_rsp, [[maybe_unused]] u64 new_rsp) {
+	asm(R"asm(
+		pushq %rbp
+		pushq %rbx
+		pushq %r12
+		pushq %r13
+		pushq %r14
+		pushq %r15
+		movq %rsp, (%rdi)
+		movq %rsi, %rsp
+		popq %r15
+		popq %r14
+		popq %r13
+		popq %r12
+		popq %rbx
+		popq %rbp
+		ret
+	)asm");
+}
+
+static bool allowed_on(const Thread* thread, const CPU* cpu) {
+	if (thread->sched_class == SchedClass::Deadline) {
+		return cpu->id == thread->deadline.cpu;
+	}
+	return thread->affinity & (u64(1) << cpu->id);
+}
+
+// whether the CPU has started scheduling, and can be given threads
+static bool is_scheduling(const CPU* cpu) {
+	return __atomic_load_n(&cpu->sched.idle, __ATOMIC_ACQUIRE) != nullptr;
+}
+
+static bool is_idle(const CPU* cpu) {
+	return __atomic_load_n(&cpu->sched.current, __ATOMIC_RELAXED) == cpu->sched.idle;
+}
+
+// these must be called with the lock of `state` held
+static void push_runnable(CPUState& state, Thread* thread) {
+	thread->next = nullptr;
+	if (state.queue_tail) {
+		state.queue_tail->next = thread;
+	} else {
+		state.queue_head = thread;
+	}
+	state.queue_tail = thread;
+	__atomic_store_n(&state.queue_length, state.queue_length + 1, __ATOMIC_RELAXED);
+}
+
+static Thread* pop_runnable(CPUState& state) {
+	auto* thread = state.queue_head;
+	if (!thread) return nullptr;
+	state.queue_head = thread->next;
+	if (!state.queue_head) {
+		state.queue_tail = nullptr;
+	}
+	thread->next = nullptr;
+	__atomic_store_n(&state.queue_length, state.queue_length - 1, __ATOMIC_RELAXED);
+	return thread;
+}
+
+static void push_deadline(CPUState& state, Thread* thread) {
+	auto** it = &state.deadline_head;
+	while (*it && (*it)->deadline.abs_deadline_ns <= thread->deadline.abs_deadline_ns) {
+		it = &(*it)->next;
+	}
+	thread->next = *it;
+	*it = thread;
+}
+
+static Thread* pop_deadline(CPUState& state) {
+	auto* thread = state.deadline_head;
+	if (!thread) return nullptr;
+	state.deadline_head = thread->next;
+	thread->next = nullptr;
+	return thread;
+}
+
+// queues the thread in the run queue of its class
+static void enqueue(CPUState& state, Thread* thread) {
+	if (thread->sched_class == SchedClass::Deadline) {
+		push_deadline(state, thread);
+	} else {
+		push_runnable(state, thread);
+	}
+}
+
+// Takes the first thread that may run on `cpu` out of the queue, and hands it over to that CPU.
+// Returns null if there is no such thread.
+static Thread* detach_for(CPUState& state, const CPU* cpu) {
+	Thread* prev = nullptr;
+	for (auto* thread = state.queue_head; thread; prev = thread, thread = thread->next) {
+		// one that's still being switched out would have to be waited for, so leave it be
+		if (!allowed_on(thread, cpu) || __atomic_load_n(&thread->on_cpu, __ATOMIC_ACQUIRE)) continue;
+
+		if (prev) {
+			prev->next = thread->next;
+		} else {
+			state.queue_head = thread->next;
+		}
+		if (state.queue_tail == thread) {
+			state.queue_tail = prev;
+		}
+		thread->next = nullptr;
+		__atomic_store_n(&state.queue_length, state.queue_length - 1, __ATOMIC_RELAXED);
+
+		__atomic_store_n(&thread->cpu, cpu->id, __ATOMIC_RELEASE);
+		thread->migrations++;
+		return thread;
+	}
+	return nullptr;
+}
+
+// Locks the run queue the thread belongs to, returning its CPU.
+static CPU* lock_thread_cpu(Thread* thread) {
+	while (true) {
+		auto* cpu = cpu::get(__atomic_load_n(&thread->cpu, __ATOMIC_ACQUIRE));
+		cpu->sched.lock.lock();
+		// it could have been moved while waiting for the lock
+		if (thread->cpu == cpu->id) return cpu;
+		cpu->sched.lock.unlock();
+	}
+}
+
+// The CPU with the shortest run queue that the thread may run on, or null if there is none.
+static CPU* pick_cpu(const Thread* thread) {
+	CPU* best = nullptr;
+	usize best_length = 0;
+	for (u32 id = 0; id < cpu::count(); ++id) {
+		auto* cpu = cpu::get(id);
+		if (!is_scheduling(cpu) || !allowed_on(thread, cpu)) continue;
+
+		const auto length = __atomic_load_n(&cpu->sched.queue_length, __ATOMIC_RELAXED);
+		if (!best || length < best_length) {
+			best = cpu;
+			best_length = length;
+		}
+	}
+	return best;
+}
+
+// The CPU other than `self` with the longest run queue, if it's at least `min_length` long.
+// Only a hint, since the lengths are read without taking any locks.
+static CPU* find_busiest(const CPU* self, usize min_length) {
+	CPU* busiest = nullptr;
+	usize busiest_length = 0;
+	for (u32 id = 0; id < cpu::count(); ++id) {
+		auto* cpu = cpu::get(id);
+		if (cpu == self || !is_scheduling(cpu)) continue;
+
+		const auto length = __atomic_load_n(&cpu->sched.queue_length, __ATOMIC_RELAXED);
+		if (length >= min_length && length > busiest_length) {
+			busiest = cpu;
+			busiest_length = length;
+		}
+	}
+	return busiest;
+}
+
+static void send_reschedule(CPU* target) {
+	this_cpu()->sched.reschedule_ipis++;
+	apic::send_ipi(target->lapic_id, RESCHEDULE_VECTOR);
+}
+
+// Gets an idle CPU to look at its run queues again. One waiting in mwait only
+// needs its `need_resched` written, anything else needs an IPI.
+static void wake_idle(CPU* target) {
+	if (!idle::wake(target, &target->sched.need_resched)) {
+		send_reschedule(target);
+	}
+}
+
+// Whether the earliest deadline thread waiting on this CPU should run instead of the current one.
+static bool deadline_preempts(CPUState& state) {
+	state.lock.lock();
+	const auto* head = state.deadline_head;
+	const auto* current = state.current;
+	const bool preempts = head && (current->sched_class != SchedClass::Deadline
+		|| head->deadline.abs_deadline_ns < current->deadline.abs_deadline_ns);
+	state.lock.unlock();
+	return preempts;
+}
+
+// Runs on a CPU that just had a thread queued on it, to make sure it gets to run eventually.
+static void notice_queued() {
+	auto& state = this_cpu()->sched;
+	if (!state.current) return;
+
+	if (state.current == state.idle || deadline_preempts(state)) {
+		state.need_resched = true;
+	} else if (state.current->sched_class == SchedClass::Fair && !state.slice_timer.queued) {
+		// the current thread was alone until now, so it has no time slice running
+		time::start_timer(&state.slice_timer, time::monotonic_ns() + TIME_SLICE_NS);
+	}
+}
+
+// Wakes up an idle CPU, which then steals from the busiest one.
+static void kick_idle_peer() {
+	auto* self = this_cpu();
+	for (u32 id = 0; id < cpu::count(); ++id) {
+		auto* cpu = cpu::get(id);
+		if (cpu == self || !is_scheduling(cpu) || !is_idle(cpu)) continue;
+		// already on its way
+		if (__atomic_load_n(&cpu->sched.need_resched, __ATOMIC_RELAXED)) continue;
+
+		wake_idle(cpu);
+		return;
+	}
+}
+
+// Makes sure `target` notices the thread that was just queued on it.
+// Deadline threads may have to preempt whatever is running there right away.
+static void kick(CPU* target, bool deadline) {
+	if (target == this_cpu()) {
+		notice_queued();
+	} else if (is_idle(target)) {
+		wake_idle(target);
+	} else if (deadline || !__atomic_load_n(&target->sched.slice_timer.queued, __ATOMIC_RELAXED)) {
+		// otherwise it finds the thread by itself once its time slice is over
+		send_reschedule(target);
+	}
+
+	// a fair thread has to wait its turn over there, so maybe someone else can take it sooner
+	if (!deadline && !is_idle(target)) {
+		kick_idle_peer();
+	}
+}
+
+// Takes a thread from the busiest CPU, for when this one has nothing left to run.
+// Only the busiest one is tried, and only if its lock is free, so idle CPUs never
+// end up spinning on a busy one.
+static Thread* steal(CPU* self) {
+	auto* busiest = find_busiest(self, 1);
+	if (!busiest || !busiest->sched.lock.try_lock()) return nullptr;
+
+	auto* thread = detach_for(busiest->sched, self);
+	busiest->sched.lock.unlock();
+	if (thread) {
+		self->sched.steals++;
+	}
+	return thread;
+}
+
+static void end_time_slice(time::HighResTimer*) {
+	this_cpu()->sched.need_resched = true;
+}
+
+// Charges a running deadline thread for the time since it was last charged.
+static void charge_deadline(Thread* thread, u64 now_ns) {
+	auto& deadline = thread->deadline;
+	deadline.remaining_ns -= static_cast<i64>(now_ns - deadline.exec_start_ns);
+	deadline.exec_start_ns = now_ns;
+}
+
+// Keeps a deadline thread that ran out of runtime off the CPU until its next period starts.
+// Must be called with the lock of its CPU held.
+static void throttle(Thread* thread, u64 now_ns) {
+	auto& deadline = thread->deadline;
+	if (now_ns > deadline.abs_deadline_ns) {
+		deadline.misses++;
+	}
+	deadline.throttles++;
+	deadline.throttled = true;
+	const auto next_period = deadline.abs_deadline_ns - deadline.params.deadline_ns + deadline.params.period_ns;
+	time::start_timer(&deadline.replenish_timer, next_period);
+}
+
+static void replenish(time::HighResTimer* timer) {
+	auto* thread = static_cast<Thread*>(timer->context);
+	auto* cpu = lock_thread_cpu(thread);
+
+	auto& deadline = thread->deadline;
+	// overruns are paid back out of the following periods
+	do {
+		deadline.abs_deadline_ns += deadline.params.period_ns;
+		deadline.remaining_ns += deadline.params.runtime_ns;
+	} while (deadline.remaining_ns <= 0);
+	deadline.throttled = false;
+	push_deadline(cpu->sched, thread);
+
+	cpu->sched.lock.unlock();
+	kick(cpu, true);
+}
+
+// Queues a deadline thread that just woke up. Following the CBS wake up rule, it only keeps its
+// old deadline and runtime if using that runtime up by then stays within its bandwidth.
+// Returns false if it was throttled instead. Must be called with the lock of its CPU held.
+static bool wake_deadline(CPUState& state, Thread* thread) {
+	auto& deadline = thread->deadline;
+	const auto& params = deadline.params;
+	const auto now = time::monotonic_ns();
+
+	if (deadline.abs_deadline_ns <= now || (deadline.remaining_ns > 0
+		&& u64(deadline.remaining_ns) * params.period_ns > (deadline.abs_deadline_ns - now) * params.runtime_ns)) {
+		deadline.abs_deadline_ns = now + params.deadline_ns;
+		deadline.remaining_ns = params.runtime_ns;
+	} else if (deadline.remaining_ns <= 0) {
+		throttle(thread, now);
+		return false;
+	}
+
+	push_deadline(state, thread);
+	return true;
+}
+
+// Gives the bandwidth reserved by a deadline thread back. Must be called with admission_lock held.
+static void release_bandwidth(Thread* thread) {
+	cpu::get(thread->deadline.cpu)->sched.deadline_bandwidth -= thread->deadline.bandwidth;
+	thread->deadline.bandwidth = 0;
+}
+
+// Pulls a thread over from the busiest CPU if it has at least two more waiting than this one.
+// Only one run queue is ever locked at a time, so there is no lock ordering to worry about.
+static void balance(time::Timer*) {
+	auto* self = this_cpu();
+	auto& state = self->sched;
+	const auto length = __atomic_load_n(&state.queue_length, __ATOMIC_RELAXED);
+
+	// a difference of one would only move the imbalance over here
+	if (auto* busiest = find_busiest(self, length + 2)) {
+		busiest->sched.lock.lock();
+		auto* thread = detach_for(busiest->sched, self);
+		busiest->sched.lock.unlock();
+
+		if (thread) {
+			state.lock.lock();
+			push_runnable(state, thread);
+			state.lock.unlock();
+			state.pulls++;
+			notice_queued();
+		}
+	} else if (length) {
+		// nobody is busier, but an idle CPU could take something from here
+		kick_idle_peer();
+	}
+
+	if (state.current != state.idle) {
+		time::mod_timer(&state.balance_timer, time::expires_ms_for(time::monotonic_ns() + BALANCE_INTERVAL_NS));
+	}
+}
+
+static void handle_reschedule() {
+	apic::send_eoi();
+	// switching happens on the way out of the interrupt, if needed
+	notice_queued();
+}
+
+// Runs on the new thread right after every switch
+static void finish_switch() {
+	auto& state = this_cpu()->sched;
+
+	const auto cycles = rdtsc() - state.switch_start;
+	state.switch_count++;
+	state.switch_total_cycles += cycles;
+	if (cycles < state.switch_min_cycles) state.switch_min_cycles = cycles;
+	if (cycles > state.switch_max_cycles) state.switch_max_cycles = cycles;
+
+	// its registers are saved now, so other CPUs may run it
+	__atomic_store_n(&state.prev->on_cpu, false, __ATOMIC_RELEASE);
+	fpu::switch_in(state.current);
+
+	if (auto* dead = state.dead) {
+		state.dead = nullptr;
+		threads_lock.lock();
+		dead->next = free_threads;
+		free_threads = dead;
+		threads_lock.unlock();
+	}
+}
+
+// Picks the next thread and switches to it. Must be called with interrupts disabled.
+static void schedule() {
+	auto* cpu = this_cpu();
+	auto& state = cpu->sched;
+	auto* prev = state.current;
+	state.need_resched = false;
+	// readers can't be switched out, so whatever ran before this isn't inside a read-side section
+	rcu::note_quiescent();
+
+	if (prev->canary != STACK_CANARY) {
+		panic("Thread {} ({}) overflowed its stack", prev->id, prev->name);
+	}
+
+	const auto now_ns = time::monotonic_ns();
+	if (prev->sched_class == SchedClass::Deadline) {
+		charge_deadline(prev, now_ns);
+	}
+
+	bool hand_over = false;
+	state.lock.lock();
+	if (prev->state == ThreadState::Running && prev != state.idle) {
+		prev->state = ThreadState::Runnable;
+		if (!allowed_on(prev, cpu)) {
+			hand_over = true;
+		} else if (prev->sched_class == SchedClass::Deadline && prev->deadline.remaining_ns <= 0) {
+			throttle(prev, now_ns);
+		} else {
+			enqueue(state, prev);
+		}
+	}
+	// deadline threads always go first
+	auto* next = pop_deadline(state);
+	if (!next) {
+		next = pop_runnable(state);
+	}
+	const bool others_waiting = state.queue_head || state.deadline_head;
+	state.lock.unlock();
+
+	if (hand_over) {
+		// its affinity changed, the CPU it goes to waits for `on_cpu` to clear before running it
+		auto* target = pick_cpu(prev);
+		if (!target) {
+			panic("Thread {} ({}) isn't allowed on any CPU", prev->id, prev->name);
+		}
+		target->sched.lock.lock();
+		__atomic_store_n(&prev->cpu, target->id, __ATOMIC_RELEASE);
+		prev->migrations++;
+		enqueue(target->sched, prev);
+		target->sched.lock.unlock();
+		state.pushes++;
+		kick(target, prev->sched_class == SchedClass::Deadline);
+	}
+
+	if (!next) {
+		next = steal(cpu);
+	}
+	if (!next) {
+		next = prev->state == ThreadState::Running ? prev : state.idle;
+	}
+
+	if (next->sched_class == SchedClass::Deadline) {
+		// deadline threads run until they block or their runtime is used up
+		next->deadline.exec_start_ns = now_ns;
+		time::start_timer(&state.slice_timer, now_ns + static_cast<u64>(next->deadline.remaining_ns));
+	} else if (next != state.idle && others_waiting) {
+		// no need to preempt anything if nothing else wants to run
+		time::start_timer(&state.slice_timer, now_ns + TIME_SLICE_NS);
+	} else {
+		time::cancel_timer(&state.slice_timer);
+	}
+	// nor to balance anything while idle, other CPUs wake this one up to steal instead
+	if (next == state.idle) {
+		time::del_timer(&state.balance_timer);
+	} else if (!state.balance_timer.is_pending()) {
+		time::mod_timer(&state.balance_timer, time::expires_ms_for(now_ns + BALANCE_INTERVAL_NS));
+	}
+
+	next->state = ThreadState::Running;
+	if (next == prev) return;
+
+	// it may have been handed over by a CPU that is still switching away from it
+	while (__atomic_load_n(&next->on_cpu, __ATOMIC_ACQUIRE)) {
+		cpu_relax();
+	}
+
+	if (prev->state == ThreadState::Dead) {
+		state.dead = prev;
+	}
+
+	const auto now = rdtsc();
+	prev->runtime_cycles += now - prev->last_switch_in;
+	next->last_switch_in = now;
+	next->switches++;
+	next->on_cpu = true;
+	state.prev = prev;
+	__atomic_store_n(&state.current, next, __ATOMIC_RELAXED);
+
+	fpu::switch_out(prev);
+	state.switch_start = rdtsc();
+	switch_context(&prev->rsp, next->rsp);
+	finish_switch();
+}
+
+[[gnu::noreturn]] static void thread_trampoline() {
+	finish_switch();
+	// schedule always runs with interrupts disabled
+	sti();
+
+	auto* thread = this_cpu()->sched.current;
+	thread->entry(thread->arg);
+	exit();
+}
+
+void kernel::sched::init() {
+	auto* cpu = this_cpu();
+	auto& state = cpu->sched;
+	state.slice_timer.callback = &end_time_slice;
+	state.balance_timer.callback = &balance;
+
+	if (cpu->id == 0) {
+		idt::set_irq_handler(RESCHEDULE_VECTOR, &handle_reschedule);
+	}
+
+	// the idle thread keeps running on whatever stack this was called on
+	auto* idle = new (alloc::allocate_page()) Thread();
+	idle->name = "idle";
+	idle->state = ThreadState::Running;
+	idle->on_cpu = true;
+	idle->cpu = cpu->id;
+	idle->affinity = u64(1) << cpu->id;
+	idle->last_switch_in = rdtsc();
+	state.current = idle;
+	// this is what lets other CPUs hand threads over to this one
+	__atomic_store_n(&state.idle, idle, __ATOMIC_RELEASE);
+
+	if (cpu->id == 0) {
+		kdbgln("Scheduler initialized");
+	}
+}
+
+void kernel::sched::idle() {
+	auto& state = this_cpu()->sched;
+	while (true) {
+		cli();
+		if (state.need_resched) {
+			schedule();
+		}
+		rcu::note_quiescent();
+		// the interrupt that ends the wait mustn't switch threads from under it,
+		// the loop does that instead once the idle time has been accounted for
+		preempt_disable();
+		// waiting isn't a latency problem, so it's left out of the preemption-off trace
+		trace_preempt_on();
+		idle::wait(&state.need_resched);
+		trace_preempt_off();
+		// interrupts are still disabled, so this doesn't switch either
+		preempt_enable();
+	}
+}
+
+Thread* kernel::sched::spawn(mat::StringView name, void (*entry)(void* arg), void* arg, u64 affinity) {
+	const auto flags = threads_lock.lock_irqsave();
+	auto* reused = free_threads;
+	if (reused) {
+		free_threads = reused->next;
+	}
+	const auto id = next_thread_id++;
+	threads_lock.unlock_irqrestore(flags);
+
+	u8* stack_base = reused ? reused->stack_base : static_cast<u8*>(alloc::allocate_pages(THREAD_STACK_SIZE / PAGE_SIZE));
+	// the SIMD save area gets reused along with the stack
+	auto* fpu_area = reused ? reused->fpu.area : nullptr;
+	auto* thread = new (stack_base) Thread();
+	thread->fpu.area = fpu_area;
+	thread->id = id;
+	thread->name = name;
+	thread->entry = entry;
+	thread->arg = arg;
+	thread->stack_base = stack_base;
+	thread->affinity = affinity;
+	// not runnable until the stack is set up, `wake` below is what queues it
+	thread->state = ThreadState::Blocked;
+
+	// start out next to whoever spawned it, stealing spreads it out from there
+	auto* cpu = this_cpu();
+	auto* target = allowed_on(thread, cpu) && is_scheduling(cpu) ? cpu : pick_cpu(thread);
+	if (!target) {
+		panic("Thread {} ({}) isn't allowed on any CPU", id, name);
+	}
+	thread->cpu = target->id;
+
+	// what switch_context expects to pop: the callee saved registers and the return address.
+	// the zero on top stands in for trampoline's own return address, to keep the stack aligned
+	auto* stack = reinterpret_cast<u64*>(stack_base + THREAD_STACK_SIZE);
+	*--stack = 0;
+	*--stack = reinterpret_cast<uptr>(&thread_trampoline);
+	for (usize i = 0; i < 6; ++i) {
+		*--stack = 0;
+	}
+	thread->rsp = reinterpret_cast<uptr>(stack);
+
+	wake(thread);
+	return thread;
+}
+
+void kernel::sched::set_affinity(u64 affinity) {
+	if (!can_block()) {
+		panic("Only threads can change their affinity");
+	}
+
+	const auto flags = irq_save();
+	auto* cpu = this_cpu();
+	cpu->sched.current->affinity = affinity;
+	// schedule hands it over to a CPU it is allowed on
+	if (!allowed_on(cpu->sched.current, cpu)) {
+		schedule();
+	}
+	irq_restore(flags);
+}
+
+bool kernel::sched::set_deadline(const DeadlineParams& params) {
+	if (!can_block()) {
+		panic("Only threads can be deadline scheduled");
+	}
+	if (!params.runtime_ns || params.runtime_ns > params.deadline_ns || params.deadline_ns > params.period_ns
+		|| params.period_ns > DEADLINE_MAX_PERIOD_NS) {
+		return false;
+	}
+	const auto bandwidth = (params.runtime_ns << BANDWIDTH_SHIFT) / params.period_ns;
+
+	const auto flags = admission_lock.lock_irqsave();
+	auto* thread = this_cpu()->sched.current;
+	auto& deadline = thread->deadline;
+	// changing parameters shouldn't fail just because of the old ones
+	const bool was_deadline = thread->sched_class == SchedClass::Deadline;
+	const auto old_bandwidth = deadline.bandwidth;
+	if (was_deadline) {
+		release_bandwidth(thread);
+	}
+
+	CPU* best = nullptr;
+	for (u32 id = 0; id < cpu::count(); ++id) {
+		auto* cpu = cpu::get(id);
+		if (!is_scheduling(cpu) || !(thread->affinity & (u64(1) << id))) continue;
+
+		const auto used = cpu->sched.deadline_bandwidth;
+		if (used + bandwidth > MAX_BANDWIDTH) continue;
+		if (!best || used < best->sched.deadline_bandwidth) {
+			best = cpu;
+		}
+	}
+	if (!best) {
+		if (was_deadline) {
+			deadline.bandwidth = old_bandwidth;
+			cpu::get(deadline.cpu)->sched.deadline_bandwidth += old_bandwidth;
+		}
+		admission_lock.unlock_irqrestore(flags);
+		return false;
+	}
+	best->sched.deadline_bandwidth += bandwidth;
+	admission_lock.unlock();
+
+	const auto now = time::monotonic_ns();
+	deadline.params = params;
+	deadline.bandwidth = bandwidth;
+	deadline.cpu = best->id;
+	deadline.abs_deadline_ns = now + params.deadline_ns;
+	deadline.remaining_ns = params.runtime_ns;
+	deadline.exec_start_ns = now;
+	deadline.replenish_timer.callback = &replenish;
+	deadline.replenish_timer.context = thread;
+	thread->sched_class = SchedClass::Deadline;
+
+	// moves it into the deadline queue, handing it over to its CPU if that's another one
+	schedule();
+	irq_restore(flags);
+	return true;
+}
+
+void kernel::sched::clear_deadline() {
+	const auto flags = admission_lock.lock_irqsave();
+	auto* thread = this_cpu()->sched.current;
+	const bool was_deadline = thread->sched_class == SchedClass::Deadline;
+	if (was_deadline) {
+		release_bandwidth(thread);
+	}
+	admission_lock.unlock();
+
+	if (was_deadline) {
+		thread->sched_class = SchedClass::Fair;
+		// back to taking turns with everything else
+		schedule();
+	}
+	irq_restore(flags);
+}
+
+Thread* kernel::sched::current() {
+	return this_cpu()->sched.current;
+}
+
+bool kernel::sched::can_block() {
+	const auto& state = this_cpu()->sched;
+	return state.current && state.current != state.idle;
+}
+
+void kernel::sched::yield() {
+	const auto flags = irq_save();
+	schedule();
+	irq_restore(flags);
+}
+
+void kernel::sched::exit() {
+	cli();
+	auto* thread = this_cpu()->sched.current;
+	if (thread->sched_class == SchedClass::Deadline) {
+		admission_lock.lock();
+		release_bandwidth(thread);
+		admission_lock.unlock();
+	}
+	thread->state = ThreadState::Dead;
+	schedule();
+	panic("Dead thread got scheduled");
+}
+
+void kernel::sched::block_current() {
+	auto& state = this_cpu()->sched;
+	auto* thread = state.current;
+	state.lock.lock();
+	if (thread->wake_pending) {
+		thread->wake_pending = false;
+		state.lock.unlock();
+		return;
+	}
+	thread->state = ThreadState::Blocked;
+	state.lock.unlock();
+	schedule();
+}
+
+void kernel::sched::wake(Thread* thread) {
+	const auto flags = irq_save();
+	auto* cpu = lock_thread_cpu(thread);
+	bool queued = false;
+	if (thread->state == ThreadState::Blocked) {
+		thread->state = ThreadState::Runnable;
+		if (thread->sched_class == SchedClass::Deadline) {
+			queued = wake_deadline(cpu->sched, thread);
+		} else {
+			push_runnable(cpu->sched, thread);
+			queued = true;
+		}
+	} else if (thread->state == ThreadState::Running) {
+		// it hasn't gotten around to blocking yet
+		thread->wake_pending = true;
+	}
+	cpu->sched.lock.unlock();
+
+	if (queued) {
+		kick(cpu, thread->sched_class == SchedClass::Deadline);
+	}
+	irq_restore(flags);
+}
+
+// the count is changed with a single instruction off of gs. going through `this_cpu` would be
+// a separate load and add, and getting preempted in between would move the thread away
+// from the CPU whose count it's about to change
+static constexpr usize PREEMPT_COUNT_OFFSET = __builtin_offsetof(CPU, sched.preempt_count);
+
+void kernel::sched::preempt_disable([[maybe_unused]] const char* file, [[maybe_unused]] u32 line) {
+	asm volatile("incl %%gs:%c0" : : "i"(PREEMPT_COUNT_OFFSET) : "memory");
+#ifdef TRACE_IRQS_OFF
+	// can't move anymore, so this_cpu is safe
+	if (this_cpu()->sched.preempt_count == 1) {
+		trace_preempt_off(file, line);
+	}
+#endif
+}
+
+void kernel::sched::preempt_enable([[maybe_unused]] const char* file, [[maybe_unused]] u32 line) {
+#ifdef TRACE_IRQS_OFF
+	if (this_cpu()->sched.preempt_count == 1) {
+		trace_preempt_on(file, line);
+	}
+#endif
+	bool enabled;
+	asm volatile("decl %%gs:%c1" : "=@ccz"(enabled) : "i"(PREEMPT_COUNT_OFFSET) : "memory");
+	if (!enabled) return;
+
+	// from here on the thread may move, but then it has already been through the scheduler
+	const auto& state = this_cpu()->sched;
+	if (state.need_resched && !state.irq_depth && state.current && interrupts_enabled()) {
+		yield();
+	}
+}
+
+void kernel::sched::handle_irq_exit() {
+	auto& state = this_cpu()->sched;
+	// read-side sections disable preemption, so the interrupted code wasn't in one
+	if (!state.preempt_count) {
+		rcu::note_quiescent();
+	}
+	if (state.need_resched && !state.preempt_count && state.current) {
+		schedule();
+	}
+}
+
+void kernel::sched::dump_stats() {
+	kdbgln("[sched] switches, avg, min, max, queued, stolen, pulled, pushed, IPIs, deadline bandwidth");
+	for (usize id = 0; id < cpu::count(); ++id) {
+		const auto* cpu = cpu::get(id);
+		if (!cpu->online || !is_scheduling(cpu)) continue;
+
+		const auto& state = cpu->sched;
+		kdbgln("[sched] cpu {}: {}, {} cycles, {} cycles, {} cycles, {}, {}, {}, {}, {}, {}%", id, state.switch_count,
+			state.switch_count ? state.switch_total_cycles / state.switch_count : 0,
+			state.switch_count ? state.switch_min_cycles : 0, state.switch_max_cycles,
+			state.queue_length, state.steals, state.pulls, state.pushes, state.reschedule_ipis,
+			state.deadline_bandwidth * 100 >> BANDWIDTH_SHIFT);
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stl/types.hpp>
+#include <stl/string.hpp>
+#include <kernel/sched/preempt.hpp>
+#include <kernel/sched/thread.hpp>
+
+namespace kernel::sched {
+
+// How long a thread gets to run before being preempted, if anything else is runnable.
+static constexpr u64 TIME_SLICE_NS = 10 * 1'000'000;
+// How often a busy CPU evens out its run queue with the others.
+static constexpr u64 BALANCE_INTERVAL_NS = 4 * 1'000'000;
+// How much of each CPU deadline threads may reserve, in percent. The rest is kept
+// for the fair class, so it can't be starved completely.
+static constexpr u64 DEADLINE_MAX_PERCENT = 95;
+// Longest period a deadline thread can have.
+static constexpr u64 DEADLINE_MAX_PERIOD_NS = 1'000'000'000;
+
+// Starts scheduling on this CPU, turning the calling context into its idle thread.
+// Threads can only be spawned after this ran on the bootstrap CPU. Must be called with
+// interrupts enabled, as it allocates.
+void init();
+
+// Becomes the idle loop of this CPU, running threads whenever there are any.
+[[gnu::noreturn]] void idle();
+
+// Creates a thread that runs `entry(arg)`, and queues it to run on one of the CPUs in `affinity`.
+Thread* spawn(mat::StringView name, void (*entry)(void* arg), void* arg = nullptr, u64 affinity = ALL_CPUS);
+
+// Restricts the calling thread to the CPUs in `affinity`, moving it right away if needed.
+// Deadline threads keep running on the CPU they were admitted on until they leave the class.
+void set_affinity(u64 affinity);
+
+// Moves the calling thread into the deadline class, on whichever allowed CPU has the most
+// bandwidth left. Returns false if the parameters are invalid or no CPU has room for it.
+bool set_deadline(const DeadlineParams& params);
+
+// Moves the calling thread back into the fair class, releasing its bandwidth.
+void clear_deadline();
+
+// The thread running on this CPU, or null if scheduling hasn't started.
+Thread* current();
+
+// Whether the calling context is a thread that can block, and not the idle
+// thread or something from before scheduling started.
+bool can_block();
+
+// Gives up the rest of the time slice to the next runnable thread, if there is one.
+void yield();
+
+// Ends the calling thread.
+[[gnu::noreturn]] void exit();
+
+// Blocks the current thread until `wake` is called on it. Must be called with interrupts
+// disabled, and returns with them still disabled. Returns right away if it was already woken.
+void block_current();
+
+// Makes a blocked thread runnable again, on the CPU it last ran on. Safe from interrupt handlers.
+void wake(Thread* thread);
+
+// Called on the way out of every interrupt, switches threads if the time slice ran out.
+void handle_irq_exit();
+
+// Prints the context switch and load balancing stats of every CPU over serial.
+void dump_stats();
+
+}
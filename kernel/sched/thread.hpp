@@ -0,0 +1,155 @@
+#pragma once
+
+#include <stl/types.hpp>
+#include <stl/string.hpp>
+#include <kernel/fpu.hpp>
+#include <kernel/time/clock_event.hpp>
+#include <kernel/time/timer_wheel.hpp>
+#include <kernel/sync/spinlock.hpp>
+
+namespace kernel::sched {
+
+static constexpr usize THREAD_STACK_SIZE = 16 * 1024;
+// sits right below the stack, so overflowing it is noticed on the next switch
+static constexpr u64 STACK_CANARY = 0x6d61'742d'6f73'2121;
+// one bit per CPU id
+static constexpr u64 ALL_CPUS = ~u64(0);
+
+enum class ThreadState : u8 {
+	Runnable,
+	Running,
+	Blocked,
+	Dead,
+};
+
+enum class SchedClass : u8 {
+	// round robin time slices, spread over CPUs by stealing and balancing
+	Fair,
+	// earliest deadline first, always runs ahead of the fair class
+	Deadline,
+};
+
+// Parameters of a deadline thread: it gets `runtime_ns` of CPU time every `period_ns`,
+// which has to be done by `deadline_ns` after the start of each period.
+struct DeadlineParams {
+	u64 runtime_ns = 0;
+	u64 deadline_ns = 0;
+	u64 period_ns = 0;
+};
+
+// Per thread state of the deadline class, budgets are enforced like SCHED_DEADLINE's
+// constant bandwidth server: a thread that runs out gets throttled until its next period.
+struct DeadlineState {
+	DeadlineParams params;
+	// share of a CPU reserved by admission control, in 1/2^20ths
+	u64 bandwidth = 0;
+	// deadline threads don't move around, they stay on the CPU they were admitted on
+	u32 cpu = 0;
+
+	u64 abs_deadline_ns = 0;
+	// runtime left in the current period, goes negative on overruns
+	i64 remaining_ns = 0;
+	// when it last started running, for charging it its runtime
+	u64 exec_start_ns = 0;
+	// out of runtime, and not in any run queue until replenished
+	bool throttled = false;
+	time::HighResTimer replenish_timer;
+
+	u64 throttles = 0;
+	// times it ran out of runtime after its deadline had already passed
+	u64 misses = 0;
+};
+
+// A kernel thread. Lives at the bottom of its own stack allocation.
+struct Thread {
+	// saved stack pointer while not running, switch_context relies on this being first
+	u64 rsp = 0;
+	u32 id = 0;
+	ThreadState state = ThreadState::Runnable;
+	// set by `wake` when it comes before the thread got to block, so the wake up isn't lost
+	bool wake_pending = false;
+	// set from being switched to until its registers are saved again after being switched out.
+	// until then it must not run anywhere else, even if it's already back in a run queue
+	bool on_cpu = false;
+	mat::StringView name = "";
+
+	// the CPU whose run queue this belongs to, and whose lock guards `state`
+	u32 cpu = 0;
+	// which CPUs this may run on, one bit per CPU id
+	u64 affinity = ALL_CPUS;
+
+	SchedClass sched_class = SchedClass::Fair;
+	DeadlineState deadline;
+
+	void (*entry)(void* arg) = nullptr;
+	void* arg = nullptr;
+
+	// null for threads that didn't get their stack from `spawn`, such as the idle threads
+	u8* stack_base = nullptr;
+	// run queue or free list link
+	Thread* next = nullptr;
+
+	u64 switches = 0;
+	u64 runtime_cycles = 0;
+	u64 last_switch_in = 0;
+	// how many times this moved to another CPU
+	u64 migrations = 0;
+
+	fpu::ThreadState fpu;
+
+	u64 canary = STACK_CANARY;
+};
+
+// Scheduler state of a CPU, part of the per-CPU data.
+struct CPUState {
+	Thread* current = nullptr;
+	// runs when there is nothing else to do, never sits in a run queue.
+	// set once this CPU starts scheduling
+	Thread* idle = nullptr;
+
+	// fair threads waiting to run on this CPU, round robin
+	Thread* queue_head = nullptr;
+	Thread* queue_tail = nullptr;
+	// other CPUs read this without the lock, to find the busiest one
+	usize queue_length = 0;
+	// deadline threads waiting to run on this CPU, sorted by absolute deadline
+	Thread* deadline_head = nullptr;
+	// guards both run queues, and the state of every thread that belongs to this CPU
+	sync::SpinLock lock;
+	// sum of the bandwidth of the deadline threads admitted here, in 1/2^20ths of the CPU
+	u64 deadline_bandwidth = 0;
+
+	// set when the current thread should be switched out as soon as it's allowed.
+	// other CPUs write it directly to wake this one from mwait while it's idle
+	bool need_resched = false;
+	// preemption is only allowed at 0
+	u32 preempt_count = 0;
+	// how many interrupt handlers deep this CPU is
+	u32 irq_depth = 0;
+	// a thread that just exited, its stack can only be reused once switched off of it
+	Thread* dead = nullptr;
+	// the thread switched away from, still marked as `on_cpu` until the switch is done
+	Thread* prev = nullptr;
+
+	// ends the current thread's time slice
+	time::HighResTimer slice_timer;
+	// evens out the run queues every so often, while this CPU is busy.
+	// it doesn't need to be precise, so it goes on the timer wheel
+	time::Timer balance_timer;
+
+	// threads taken from other CPUs when this one ran out, or by periodic balancing
+	u64 steals = 0;
+	u64 pulls = 0;
+	// threads handed to another CPU because their affinity changed
+	u64 pushes = 0;
+	u64 reschedule_ipis = 0;
+
+	// context switch cost, from right before switch_context to right after it
+	u64 switch_start = 0;
+	u64 switch_count = 0;
+	u64 switch_total_cycles = 0;
+	u64 switch_min_cycles = ~u64(0);
+	u64 switch_max_cycles = 0;
+};
+
+}
@@ -1,4 +1,5 @@
 #include <kernel/screen/canvas.hpp>
+#include <kernel/dispatch.hpp>
 
 Color::Color(u8 r, u8 g, u8 b) : b(b), g(g), r(r) {}
 
@@ -31,11 +32,11 @@ Canvas Canvas::sub(usize x, usize y, usize width, usize height) {
 }
 
 void Canvas::paste(const Canvas& subcanvas, usize x, usize y) {
+	if (x >= width()) return;
+	// row by row, each one copied with whatever the CPU does best
+	const auto row_width = subcanvas.width() < width() - x ? subcanvas.width() : width() - x;
 	for (usize j = 0; j < subcanvas.height() && y + j < height(); ++j) {
-		for (usize i = 0; i < subcanvas.width() && x + i < width(); ++i) {
-			// pixel by pixel! very slow..
-			this->set(x + i, j + i, subcanvas.get(i, j));
-		}
+		kernel::dispatch::copy32(data() + index(x, y + j), subcanvas.data() + subcanvas.index(0, j), row_width);
 	}
 }
 
@@ -52,9 +53,9 @@ usize Canvas::index(usize x, usize y) const {
 }
 
 void Canvas::fill(usize x, usize y, usize width, usize height, Color color) {
+	if (x >= this->width()) return;
+	const auto row_width = width < this->width() - x ? width : this->width() - x;
 	for (usize j = 0; j < height && y + j < this->height(); ++j) {
-		for (usize i = 0; i < width && x + i < this->width(); ++i) {
-			this->set(x + i, y + j, color);
-		}
+		kernel::dispatch::fill32(data() + index(x, y + j), color.packed, row_width);
 	}
 }
\ No newline at end of file
@@ -2,6 +2,17 @@
 #include <kernel/screen/terminal.hpp>
 #include <kernel/screen/framebuffer.hpp>
 #include <kernel/screen/terminal_font.hpp>
+#include <kernel/device/keyboard.hpp>
+#include <kernel/device/mouse.hpp>
+#include <kernel/input/input.hpp>
+#include <kernel/sched/scheduler.hpp>
+#include <kernel/async/executor.hpp>
+#include <kernel/sync/rcu.hpp>
+#include <kernel/memory/tlb.hpp>
+#include <kernel/irq_stats.hpp>
+#include <kernel/irq_trace.hpp>
+#include <kernel/idle.hpp>
+#include <kernel/fpu.hpp>
 #include <kernel/log.hpp>
 
 using mat::math::get_bit;
@@ -63,4 +74,53 @@ void kernel::terminal::type_character(char ch) {
 		column = 0;
 		++row;
 	}
-}
\ No newline at end of file
+}
+
+static void dump_all_stats() {
+	kernel::irq_stats::dump();
+	kernel::irq_trace::report();
+	kernel::tlb::dump_stats();
+	kernel::sched::dump_stats();
+	kernel::async::dump_stats();
+	kernel::rcu::dump_stats();
+	kernel::idle::dump_stats();
+	kernel::fpu::dump_stats();
+	kernel::keyboard::dump_stats();
+	kernel::mouse::dump_stats();
+	kernel::input::dump_stats();
+}
+
+constinit static kernel::input::Consumer input_consumer;
+
+static void handle_input(void*) {
+	using kernel::keyboard::KeyKind;
+	using kernel::input::Source;
+
+	kernel::input::Event events[16];
+	while (true) {
+		const auto count = input_consumer.read(events, 16);
+		for (usize i = 0; i < count; ++i) {
+			const auto& event = events[i];
+			// nothing to point at yet
+			if (event.source != Source::Keyboard) continue;
+
+			const auto& key = event.key;
+			if (!key.pressed) continue;
+
+			if (key.ch) {
+				kernel::terminal::type_character(key.ch);
+				kernel::input::note_displayed(event);
+			} else if (key.kind == KeyKind::F12) {
+				dump_all_stats();
+			} else if (key.kind == KeyKind::Other) {
+				kdbg("({:02x})", key.code);
+			}
+		}
+	}
+}
+
+void kernel::terminal::init() {
+	input::set_focus(&input_consumer);
+	sched::spawn("terminal", &handle_input, nullptr);
+	kdbgln("Terminal initialized");
+}
@@ -5,4 +5,8 @@ namespace kernel::terminal {
 // Prints an ascii character on screen
 void type_character(char ch);
 
+// Takes the input focus and starts the thread that types whatever comes in from the keyboard.
+// Must be called after `sched::init`.
+void init();
+
 }
\ No newline at end of file
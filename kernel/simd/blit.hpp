@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stl/types.hpp>
+
+// SIMD versions of the dispatch table blitters. These are compiled with SIMD enabled,
+// so they may only be called between `fpu::begin` and `fpu::end`.
+namespace kernel::simd {
+
+void fill32_sse2(u32* dest, u32 value, usize count);
+void copy32_sse2(u32* dest, const u32* src, usize count);
+
+void fill32_avx2(u32* dest, u32 value, usize count);
+void copy32_avx2(u32* dest, const u32* src, usize count);
+
+}
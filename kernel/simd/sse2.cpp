@@ -0,0 +1,36 @@
+#include <kernel/simd/blit.hpp>
+
+// only plain types in here, any inline function from a header would get compiled with
+// SIMD too, and the linker could pick that copy for the rest of the kernel
+
+typedef u32 Vector __attribute__((vector_size(16)));
+
+static constexpr usize LANES = sizeof(Vector) / sizeof(u32);
+
+void kernel::simd::fill32_sse2(u32* dest, u32 value, usize count) {
+	Vector pattern;
+	for (usize i = 0; i < LANES; ++i) {
+		pattern[i] = value;
+	}
+
+	usize i = 0;
+	for (; i + LANES <= count; i += LANES) {
+		// unaligned store, rows don't have to start on a vector boundary
+		__builtin_memcpy(dest + i, &pattern, sizeof(pattern));
+	}
+	for (; i < count; ++i) {
+		dest[i] = value;
+	}
+}
+
+void kernel::simd::copy32_sse2(u32* dest, const u32* src, usize count) {
+	usize i = 0;
+	for (; i + LANES <= count; i += LANES) {
+		Vector pixels;
+		__builtin_memcpy(&pixels, src + i, sizeof(pixels));
+		__builtin_memcpy(dest + i, &pixels, sizeof(pixels));
+	}
+	for (; i < count; ++i) {
+		dest[i] = src[i];
+	}
+}
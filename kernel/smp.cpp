@@ -0,0 +1,101 @@
+#include <limine/limine.h>
+#include <kernel/smp.hpp>
+#include <kernel/cpu.hpp>
+#include <kernel/idt.hpp>
+#include <kernel/fpu.hpp>
+#include <kernel/device/apic.hpp>
+#include <kernel/device/lapic_timer.hpp>
+#include <kernel/sched/scheduler.hpp>
+#include <kernel/memory/tlb.hpp>
+#include <kernel/time/time.hpp>
+#include <kernel/log.hpp>
+#include <kernel/intrinsics.hpp>
+
+using namespace kernel;
+
+static volatile limine_smp_request smp_request = {
+	.id = LIMINE_SMP_REQUEST,
+	.revision = 0,
+	.response = nullptr,
+	// only does anything if the CPU supports it, same as apic::init
+	.flags = LIMINE_SMP_X2APIC,
+};
+
+// how long to wait for the other CPUs before giving up on them
+static constexpr u64 STARTUP_TIMEOUT_MS = 1000;
+
+static usize online = 1;
+
+// the APs might not start on the same page tables, and their stacks are only mapped in these
+static u64 kernel_cr3 = 0;
+
+[[gnu::noreturn]] static void ap_main(CPU* cpu) {
+	cpu::init_current(cpu);
+	idt::load();
+	fpu::init_cpu();
+	apic::init_local();
+	tlb::activate();
+	lapic_timer::init_local();
+
+	__atomic_store_n(&cpu->online, true, __ATOMIC_RELEASE);
+	__atomic_fetch_add(&online, 1, __ATOMIC_RELEASE);
+
+	// allocating may need to answer TLB shootdowns, so interrupts have to be on first
+	sti();
+	sched::init();
+	sched::idle();
+}
+
+static void ap_entry(limine_smp_info* info) {
+	auto* cpu = reinterpret_cast<CPU*>(info->extra_argument);
+	// switch over to our page tables and stack, then never come back
+	asm volatile(R"asm(
+		movq %0, %%cr3
+		movq %1, %%rsp
+		xorq %%rbp, %%rbp
+		call *%2
+	)asm" : : "r"(kernel_cr3), "r"(cpu->stack_top), "r"(&ap_main), "D"(cpu) : "memory");
+	__builtin_unreachable();
+}
+
+void kernel::smp::init() {
+	const auto* response = smp_request.response;
+	if (!response) {
+		kdbgln("[smp] no response for the SMP request, only using the bootstrap CPU");
+		return;
+	}
+
+	kernel_cr3 = get_cr3();
+	this_cpu()->lapic_id = response->bsp_lapic_id;
+
+	usize started = 1;
+	for (u64 i = 0; i < response->cpu_count; ++i) {
+		auto* info = response->cpus[i];
+		if (info->lapic_id == response->bsp_lapic_id) continue;
+		if (cpu::count() >= MAX_CPUS) {
+			kdbgln("[smp] more than {} CPUs, ignoring the rest", MAX_CPUS);
+			break;
+		}
+
+		auto* cpu = cpu::create(info->lapic_id);
+		info->extra_argument = reinterpret_cast<uptr>(cpu);
+		// writing the address is what starts the CPU
+		__atomic_store_n(&info->goto_address, &ap_entry, __ATOMIC_SEQ_CST);
+		started++;
+	}
+
+	const auto deadline = time::monotonic_ns() + STARTUP_TIMEOUT_MS * time::NS_PER_MS;
+	while (online_count() < started && time::monotonic_ns() < deadline) {
+		cpu_relax();
+	}
+
+	if (online_count() < started) {
+		kdbgln("[smp] only {} out of {} CPUs came online", online_count(), started);
+	}
+
+	kdbgln("SMP initialized, {} CPUs online", online_count());
+}
+
+usize kernel::smp::online_count() {
+	return __atomic_load_n(&online, __ATOMIC_ACQUIRE);
+}
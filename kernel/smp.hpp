@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stl/types.hpp>
+
+namespace kernel::smp {
+
+// Starts every other CPU limine found, and waits for them to come online.
+// Each gets its own stack, GDT, TSS and per-CPU data, then sits idle in `hlt`.
+void init();
+
+// How many CPUs are up and running, including the bootstrap CPU.
+usize online_count();
+
+}
@@ -0,0 +1,157 @@
+#include <kernel/sync/futex.hpp>
+#include <kernel/sync/spinlock.hpp>
+#include <kernel/sync/wait_queue.hpp>
+#include <kernel/time/timer_wheel.hpp>
+#include <kernel/time/time.hpp>
+#include <kernel/log.hpp>
+
+using namespace kernel;
+using namespace kernel::sync;
+
+struct FutexWaiter {
+	Waiter waiter;
+	const u32* addr = nullptr;
+	FutexWaiter* next = nullptr;
+};
+
+struct Bucket {
+	// oldest first
+	FutexWaiter* head = nullptr;
+	FutexWaiter* tail = nullptr;
+	SpinLock lock;
+};
+
+static Bucket buckets[futex::BUCKET_COUNT];
+
+static Bucket& bucket_for(const u32* addr) {
+	// fibonacci hashing, the low bits of an address don't vary much
+	const auto hash = (reinterpret_cast<uptr>(addr) >> 2) * 0x9e3779b97f4a7c15;
+	static_assert((futex::BUCKET_COUNT & (futex::BUCKET_COUNT - 1)) == 0);
+	return buckets[hash >> (64 - __builtin_ctzll(futex::BUCKET_COUNT))];
+}
+
+// these must be called with the lock of `bucket` held
+static void enqueue(Bucket& bucket, FutexWaiter* waiter) {
+	waiter->next = nullptr;
+	if (bucket.tail) {
+		bucket.tail->next = waiter;
+	} else {
+		bucket.head = waiter;
+	}
+	bucket.tail = waiter;
+}
+
+// returns whether the waiter was still queued
+static bool remove(Bucket& bucket, FutexWaiter* waiter) {
+	FutexWaiter* prev = nullptr;
+	for (auto* it = bucket.head; it; prev = it, it = it->next) {
+		if (it != waiter) continue;
+
+		if (prev) {
+			prev->next = it->next;
+		} else {
+			bucket.head = it->next;
+		}
+		if (bucket.tail == it) {
+			bucket.tail = prev;
+		}
+		it->next = nullptr;
+		return true;
+	}
+	return false;
+}
+
+// a timeout of 0 waits forever
+static futex::WaitResult wait_on(u32* addr, u32 expected, u64 timeout_ns) {
+	if (!sched::can_block()) {
+		panic("Only threads can wait on a futex");
+	}
+
+	auto& bucket = bucket_for(addr);
+	const auto flags = bucket.lock.lock_irqsave();
+	if (!(flags & RFLAGS_IF)) {
+		panic("Tried to block with interrupts disabled");
+	}
+	// pairs with whatever the waker changed before calling wake, which takes this same lock
+	if (__atomic_load_n(addr, __ATOMIC_SEQ_CST) != expected) {
+		bucket.lock.unlock_irqrestore(flags);
+		return futex::WaitResult::ValueChanged;
+	}
+
+	FutexWaiter waiter;
+	waiter.addr = addr;
+	// whoever wakes it takes it out of the bucket, or the timeout below does
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdangling-pointer"
+	enqueue(bucket, &waiter);
+#pragma GCC diagnostic pop
+	bucket.lock.unlock();
+
+	if (!timeout_ns) {
+		block(&waiter.waiter);
+		irq_restore(flags);
+		return futex::WaitResult::Woken;
+	}
+
+	// the timer only wakes the waiter, it's still in the bucket afterwards
+	time::Timer timeout;
+	timeout.expires_ms = time::expires_ms_for(time::monotonic_ns() + timeout_ns);
+	timeout.context = &waiter.waiter;
+	timeout.callback = [](time::Timer* timer) {
+		sync::wake(static_cast<Waiter*>(timer->context));
+	};
+	time::add_timer(&timeout);
+
+	block(&waiter.waiter);
+
+	// whoever woke us through the bucket also took us out of it
+	bucket.lock.lock();
+	const bool timed_out = remove(bucket, &waiter);
+	bucket.lock.unlock();
+	// the callback may still be running on the CPU this blocked on
+	time::del_timer_sync(&timeout);
+	irq_restore(flags);
+	return timed_out ? futex::WaitResult::TimedOut : futex::WaitResult::Woken;
+}
+
+futex::WaitResult kernel::sync::futex::wait(u32* addr, u32 expected) {
+	return wait_on(addr, expected, 0);
+}
+
+futex::WaitResult kernel::sync::futex::wait_for(u32* addr, u32 expected, u64 timeout_ns) {
+	// a zero timeout would otherwise mean forever
+	return wait_on(addr, expected, timeout_ns ? timeout_ns : 1);
+}
+
+usize kernel::sync::futex::wake(u32* addr, u32 count) {
+	auto& bucket = bucket_for(addr);
+	const auto flags = bucket.lock.lock_irqsave();
+
+	usize woken = 0;
+	FutexWaiter* prev = nullptr;
+	for (auto* it = bucket.head; it && woken < count;) {
+		auto* next = it->next;
+		if (it->addr != addr) {
+			prev = it;
+			it = next;
+			continue;
+		}
+
+		if (prev) {
+			prev->next = next;
+		} else {
+			bucket.head = next;
+		}
+		if (bucket.tail == it) {
+			bucket.tail = prev;
+		}
+		it->next = nullptr;
+		// once woken, the waiter may go out of scope at any moment
+		sync::wake(&it->waiter);
+		++woken;
+		it = next;
+	}
+
+	bucket.lock.unlock_irqrestore(flags);
+	return woken;
+}
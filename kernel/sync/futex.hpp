@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stl/types.hpp>
+
+namespace kernel::sync::futex {
+
+// Waiters are hashed by address into this many buckets, each with its own lock and queue.
+// Unrelated futexes may share a bucket, which only costs skipping over each other's waiters.
+static constexpr usize BUCKET_COUNT = 64;
+
+// Pass to `wake` to wake up every waiter on the address.
+static constexpr u32 WAKE_ALL = ~u32(0);
+
+enum class WaitResult {
+	Woken,
+	// `*addr` wasn't `expected` anymore, so it never went to sleep
+	ValueChanged,
+	TimedOut,
+};
+
+// Blocks the calling thread while `*addr == expected`, until `wake` is called on the
+// same address. The value is checked with the bucket locked, so a wake that comes right
+// after the caller last looked at it isn't lost. Wake ups may be spurious, callers
+// should check their condition again. Only threads can wait.
+// Addresses are kernel virtual addresses for now, a user space version would have to
+// key on the physical address instead, for memory shared between address spaces.
+WaitResult wait(u32* addr, u32 expected);
+
+// Same as `wait`, but gives up after `timeout_ns`, rounded up to the next millisecond.
+WaitResult wait_for(u32* addr, u32 expected, u64 timeout_ns);
+
+// Wakes up to `count` threads waiting on `addr`, oldest first, returning how many there were.
+// Safe from interrupt handlers, and from any CPU.
+usize wake(u32* addr, u32 count);
+
+}
@@ -0,0 +1,93 @@
+#include <kernel/sync/mutex.hpp>
+#include <kernel/sync/futex.hpp>
+#include <kernel/log.hpp>
+#include <kernel/intrinsics.hpp>
+
+using namespace kernel;
+using namespace kernel::sync;
+
+void Mutex::lock_slow() {
+	if (!sched::can_block()) {
+		panic("Only threads can lock a mutex");
+	}
+	auto* self = sched::current();
+
+	// the owner is running, so it'll probably let go soon, and sleeping would cost more than waiting
+	for (usize i = 0; i < MUTEX_MAX_SPINS; ++i) {
+		auto* owner = this->owner();
+		if (owner == self) {
+			panic("Tried to lock a mutex twice from the same thread");
+		}
+		// the owner is null for a moment between taking the lock and storing it
+		if (owner && !__atomic_load_n(&owner->on_cpu, __ATOMIC_RELAXED)) break;
+
+		u32 expected = 0;
+		if (__atomic_load_n(&m_state, __ATOMIC_RELAXED) == 0
+			&& __atomic_compare_exchange_n(&m_state, &expected, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			return;
+		}
+		cpu_relax();
+	}
+
+	// mark it as contended so the unlock wakes us up. this may take the lock with a 2
+	// even when nobody else is sleeping, which only costs one spurious wake later
+	while (__atomic_exchange_n(&m_state, 2, __ATOMIC_ACQUIRE) != 0) {
+		futex::wait(&m_state, 2);
+	}
+}
+
+void Mutex::wake_waiter() {
+	futex::wake(&m_state, 1);
+}
+
+bool Semaphore::try_down() {
+	auto count = __atomic_load_n(&m_count, __ATOMIC_RELAXED);
+	while (count) {
+		if (__atomic_compare_exchange_n(&m_count, &count, count - 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void Semaphore::down() {
+	for (usize i = 0; i < SEMAPHORE_MAX_SPINS; ++i) {
+		if (try_down()) return;
+		cpu_relax();
+	}
+
+	if (!sched::can_block()) {
+		panic("Only threads can wait on a semaphore");
+	}
+	// counted before checking, so that an `up` either sees us or leaves a count we see
+	__atomic_fetch_add(&m_waiters, 1, __ATOMIC_SEQ_CST);
+	while (!try_down()) {
+		futex::wait(&m_count, 0);
+	}
+	__atomic_fetch_sub(&m_waiters, 1, __ATOMIC_RELAXED);
+}
+
+void Semaphore::up(u32 count) {
+	__atomic_fetch_add(&m_count, count, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&m_waiters, __ATOMIC_SEQ_CST)) {
+		futex::wake(&m_count, count);
+	}
+}
+
+void ConditionVariable::wait(Mutex& mutex) {
+	// a notify between reading this and sleeping changes it, so the futex won't sleep
+	const auto sequence = __atomic_load_n(&m_sequence, __ATOMIC_ACQUIRE);
+	mutex.unlock();
+	futex::wait(&m_sequence, sequence);
+	mutex.lock();
+}
+
+void ConditionVariable::notify_one() {
+	__atomic_fetch_add(&m_sequence, 1, __ATOMIC_RELEASE);
+	futex::wake(&m_sequence, 1);
+}
+
+void ConditionVariable::notify_all() {
+	__atomic_fetch_add(&m_sequence, 1, __ATOMIC_RELEASE);
+	futex::wake(&m_sequence, futex::WAKE_ALL);
+}
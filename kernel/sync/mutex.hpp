@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stl/types.hpp>
+#include <kernel/sched/scheduler.hpp>
+
+namespace kernel::sync {
+
+// How long to keep spinning on a mutex whose owner is running on another CPU,
+// before giving up and sleeping. Long enough for a short critical section to end,
+// short enough that waiting on a long one doesn't burn much.
+static constexpr usize MUTEX_MAX_SPINS = 4096;
+// Semaphores have no owner to watch, so they only spin this much before sleeping.
+static constexpr usize SEMAPHORE_MAX_SPINS = 256;
+
+// A sleeping lock, for critical sections that may take a while or block.
+// Uncontended locking is a single atomic. When contended, it spins for as long as the
+// owner is running on another CPU, and otherwise sleeps on a futex until unlocked.
+// Only threads can take it, and never from interrupt handlers.
+class Mutex {
+	// 0 when unlocked, 1 when locked, 2 when locked with someone possibly sleeping on it
+	u32 m_state = 0;
+	sched::Thread* m_owner = nullptr;
+
+	void lock_slow();
+	void wake_waiter();
+
+public:
+	void lock() {
+		u32 expected = 0;
+		if (!__atomic_compare_exchange_n(&m_state, &expected, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			lock_slow();
+		}
+		__atomic_store_n(&m_owner, sched::current(), __ATOMIC_RELAXED);
+	}
+
+	bool try_lock() {
+		u32 expected = 0;
+		if (!__atomic_compare_exchange_n(&m_state, &expected, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			return false;
+		}
+		__atomic_store_n(&m_owner, sched::current(), __ATOMIC_RELAXED);
+		return true;
+	}
+
+	void unlock() {
+		__atomic_store_n(&m_owner, nullptr, __ATOMIC_RELAXED);
+		// only go into the futex when someone could be sleeping
+		if (__atomic_exchange_n(&m_state, 0, __ATOMIC_RELEASE) == 2) {
+			wake_waiter();
+		}
+	}
+
+	bool is_locked() const { return __atomic_load_n(&m_state, __ATOMIC_RELAXED) != 0; }
+
+	// The thread holding the lock. Might be a bit out of date, and is null for a moment
+	// right after locking.
+	sched::Thread* owner() const { return __atomic_load_n(&m_owner, __ATOMIC_RELAXED); }
+};
+
+// A counting semaphore. `down` spins a little while the count is 0, then sleeps until an `up`.
+class Semaphore {
+	u32 m_count;
+	// threads that are (or are about to be) sleeping, so `up` can skip the futex when there are none
+	u32 m_waiters = 0;
+
+public:
+	explicit Semaphore(u32 count = 0) : m_count(count) {}
+
+	// Takes one from the count, waiting for it to be non zero. Only threads can wait.
+	void down();
+
+	// Takes one from the count if it's non zero, without waiting.
+	bool try_down();
+
+	// Adds `count`, waking up that many waiters. Safe from interrupt handlers.
+	void up(u32 count = 1);
+
+	u32 count() const { return __atomic_load_n(&m_count, __ATOMIC_RELAXED); }
+};
+
+// Lets threads wait for some condition protected by a mutex to change.
+class ConditionVariable {
+	// bumped by every notify, so a waiter can tell whether it missed one while unlocking
+	u32 m_sequence = 0;
+
+public:
+	// Unlocks `mutex` and sleeps until notified, locking it again before returning.
+	// Wake ups may be spurious, so this should be called in a loop, see `wait_until`.
+	void wait(Mutex& mutex);
+
+	// Waits until `condition` returns true, which is checked with `mutex` locked.
+	template <class Func>
+	void wait_until(Mutex& mutex, Func condition) {
+		while (!condition()) {
+			wait(mutex);
+		}
+	}
+
+	// Wakes up the oldest waiter.
+	void notify_one();
+
+	// Wakes up every waiter.
+	void notify_all();
+};
+
+}
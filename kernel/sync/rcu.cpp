@@ -0,0 +1,141 @@
+#include <kernel/sync/rcu.hpp>
+#include <kernel/sync/wait_queue.hpp>
+#include <kernel/sched/scheduler.hpp>
+#include <kernel/device/apic.hpp>
+#include <kernel/time/time.hpp>
+#include <kernel/idt.hpp>
+#include <kernel/cpu.hpp>
+#include <kernel/log.hpp>
+
+using namespace kernel;
+
+// bumped at the start of every grace period, a CPU has gone through grace period N
+// once its `quiescent_seq` reaches N
+static u64 gp_seq = 0;
+
+// the RCU thread sleeps on this while there are no callbacks
+static sync::WaitQueue callbacks_queue;
+
+static u64 grace_periods = 0;
+static u64 callbacks_run = 0;
+
+static bool is_quiescent(const CPU* cpu, u64 target) {
+	// CPUs that aren't scheduling yet can't be inside a read-side section that started before
+	if (!cpu->online || !__atomic_load_n(&cpu->sched.idle, __ATOMIC_ACQUIRE)) return true;
+	return __atomic_load_n(&cpu->rcu.quiescent_seq, __ATOMIC_ACQUIRE) >= target;
+}
+
+// Interrupts the CPUs that haven't gone through a quiescent state yet. Whatever they were
+// running, the interrupt either lands outside of a read-side section, or switches threads
+// at the end of it. Idle CPUs just go around their loop once more.
+static bool kick_lagging(u64 target) {
+	bool all_quiescent = true;
+	for (u32 id = 0; id < cpu::count(); ++id) {
+		auto* cpu = cpu::get(id);
+		if (is_quiescent(cpu, target)) continue;
+
+		all_quiescent = false;
+		if (cpu != this_cpu()) {
+			__atomic_fetch_add(&this_cpu()->rcu.kicks, 1, __ATOMIC_RELAXED);
+			apic::send_ipi(cpu->lapic_id, RESCHEDULE_VECTOR);
+		}
+	}
+	return all_quiescent;
+}
+
+static bool has_callbacks() {
+	for (u32 id = 0; id < cpu::count(); ++id) {
+		if (__atomic_load_n(&cpu::get(id)->rcu.callbacks, __ATOMIC_RELAXED)) return true;
+	}
+	return false;
+}
+
+static void run_callbacks(void*) {
+	while (true) {
+		callbacks_queue.wait_until([] { return has_callbacks(); });
+
+		// everything queued so far shares the one grace period
+		rcu::Head* batch = nullptr;
+		for (u32 id = 0; id < cpu::count(); ++id) {
+			auto* head = __atomic_exchange_n(&cpu::get(id)->rcu.callbacks, nullptr, __ATOMIC_ACQUIRE);
+			while (head) {
+				auto* next = head->next;
+				head->next = batch;
+				batch = head;
+				head = next;
+			}
+		}
+
+		rcu::synchronize();
+
+		while (batch) {
+			// the callback usually frees whatever the head is embedded in
+			auto* next = batch->next;
+			batch->func(batch);
+			batch = next;
+			callbacks_run++;
+		}
+	}
+}
+
+void kernel::rcu::init() {
+	sched::spawn("rcu", &run_callbacks);
+
+	kdbgln("RCU initialized");
+}
+
+void kernel::rcu::note_quiescent() {
+	auto& state = this_cpu()->rcu;
+	const auto seq = __atomic_load_n(&gp_seq, __ATOMIC_ACQUIRE);
+	// the common case, nobody started a new grace period since last time
+	if (state.quiescent_seq == seq) return;
+
+	state.quiescent_count++;
+	// the release keeps every load from earlier read-side sections before this
+	__atomic_store_n(&state.quiescent_seq, seq, __ATOMIC_RELEASE);
+}
+
+void kernel::rcu::synchronize() {
+	if (!sched::can_block()) {
+		panic("Only threads can wait for a grace period");
+	}
+
+	// whatever got unpublished before this is unreachable for readers that start after it
+	const auto target = __atomic_add_fetch(&gp_seq, 1, __ATOMIC_SEQ_CST);
+	// this CPU is clearly not in a read-side section, since it's about to block
+	sched::preempt_disable();
+	note_quiescent();
+	sched::preempt_enable();
+
+	// busy CPUs usually switch threads or take an interrupt soon enough on their own
+	sleep_for(POLL_INTERVAL_NS);
+	while (!kick_lagging(target)) {
+		sleep_for(POLL_INTERVAL_NS);
+	}
+
+	__atomic_fetch_add(&grace_periods, 1, __ATOMIC_RELAXED);
+}
+
+void kernel::rcu::call(Head* head, void (*func)(Head* head)) {
+	head->func = func;
+
+	// pushing onto the list of whatever CPU this is on, so disable interrupts to stay there
+	const auto flags = irq_save();
+	auto& list = this_cpu()->rcu.callbacks;
+	head->next = __atomic_load_n(&list, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&list, &head->next, head, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	irq_restore(flags);
+
+	callbacks_queue.wake_one();
+}
+
+void kernel::rcu::dump_stats() {
+	kdbgln("[rcu] {} grace periods, {} callbacks run", grace_periods, callbacks_run);
+	kdbgln("[rcu] quiescent states, kicks sent");
+	for (u32 id = 0; id < cpu::count(); ++id) {
+		const auto* cpu = cpu::get(id);
+		if (!cpu->online) continue;
+
+		kdbgln("[rcu] cpu {}: {}, {}", id, cpu->rcu.quiescent_count, cpu->rcu.kicks);
+	}
+}
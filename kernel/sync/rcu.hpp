@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stl/types.hpp>
+#include <kernel/sched/preempt.hpp>
+
+namespace kernel::rcu {
+
+// How often `synchronize` checks whether the grace period is over. CPUs that haven't
+// gone through a quiescent state by then get an IPI, which makes them report one.
+static constexpr u64 POLL_INTERVAL_NS = 500'000;
+
+// Something waiting for a grace period to end, embedded in whatever it's going to free.
+struct Head {
+	Head* next = nullptr;
+	void (*func)(Head* head) = nullptr;
+};
+
+// Per-CPU quiescent state tracking, part of the per-CPU data.
+struct CPUState {
+	// the latest grace period this CPU went through a quiescent state in
+	u64 quiescent_seq = 0;
+	// callbacks queued on this CPU, pushed atomically and taken all at once by the RCU thread
+	Head* callbacks = nullptr;
+	u64 quiescent_count = 0;
+	u64 kicks = 0;
+};
+
+// Read-side critical sections just disable preemption, so the only cost is bumping a
+// per-CPU counter. Anything read in here stays valid until `read_unlock`, even if an
+// updater unpublishes it in the meantime. Readers must not block, and may nest.
+inline void read_lock(const char* file = __builtin_FILE(), u32 line = __builtin_LINE()) {
+	sched::preempt_disable(file, line);
+}
+
+inline void read_unlock(const char* file = __builtin_FILE(), u32 line = __builtin_LINE()) {
+	sched::preempt_enable(file, line);
+}
+
+// Loads a pointer published with `assign`, for use inside a read-side section.
+template <class T>
+T* dereference(T* const& slot) {
+	return __atomic_load_n(&slot, __ATOMIC_ACQUIRE);
+}
+
+// Publishes a pointer for readers, after everything it points to was written.
+template <class T>
+void assign(T*& slot, T* value) {
+	__atomic_store_n(&slot, value, __ATOMIC_RELEASE);
+}
+
+// Starts the thread that runs `call` callbacks. Must be called after `sched::init`.
+void init();
+
+// Records that this CPU isn't inside a read-side section. Called by the scheduler on
+// every context switch, from the idle loop, and when an interrupt lands outside of one.
+void note_quiescent();
+
+// Blocks until every read-side section that was running when this got called is over.
+// Only threads can wait. Concurrent callers each wait for their own grace period.
+void synchronize();
+
+// Calls `func(head)` from the RCU thread once a grace period has passed, without
+// waiting for it. Safe from interrupt handlers, and from any CPU.
+void call(Head* head, void (*func)(Head* head));
+
+// Prints the grace period and quiescent state stats over serial.
+void dump_stats();
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stl/types.hpp>
+#include <kernel/intrinsics.hpp>
+#include <kernel/sched/preempt.hpp>
+
+namespace kernel::sync {
+
+// A simple test and test-and-set lock, for short critical sections shared between CPUs.
+// Data that is also touched by interrupt handlers should use `lock_irqsave`, otherwise
+// an interrupt on the CPU holding the lock would deadlock trying to take it again.
+class SpinLock {
+	bool m_locked = false;
+
+public:
+	void lock(const char* file = __builtin_FILE(), u32 line = __builtin_LINE()) {
+		// the holder must not be switched out, or anyone else on this CPU would spin until its next time slice
+		sched::preempt_disable(file, line);
+		while (__atomic_exchange_n(&m_locked, true, __ATOMIC_ACQUIRE)) {
+			// spin on a plain load, so the cache line isn't bounced around while waiting
+			while (__atomic_load_n(&m_locked, __ATOMIC_RELAXED)) {
+				cpu_relax();
+			}
+		}
+	}
+
+	bool try_lock(const char* file = __builtin_FILE(), u32 line = __builtin_LINE()) {
+		sched::preempt_disable(file, line);
+		if (__atomic_exchange_n(&m_locked, true, __ATOMIC_ACQUIRE)) {
+			sched::preempt_enable(file, line);
+			return false;
+		}
+		return true;
+	}
+
+	void unlock(const char* file = __builtin_FILE(), u32 line = __builtin_LINE()) {
+		__atomic_store_n(&m_locked, false, __ATOMIC_RELEASE);
+		sched::preempt_enable(file, line);
+	}
+
+	bool is_locked() const {
+		return __atomic_load_n(&m_locked, __ATOMIC_RELAXED);
+	}
+
+	// Disables interrupts and takes the lock, returning the flags for `unlock_irqrestore`.
+	u64 lock_irqsave(const char* file = __builtin_FILE(), u32 line = __builtin_LINE()) {
+		const auto flags = irq_save(file, line);
+		lock(file, line);
+		return flags;
+	}
+
+	void unlock_irqrestore(u64 flags, const char* file = __builtin_FILE(), u32 line = __builtin_LINE()) {
+		unlock(file, line);
+		irq_restore(flags, file, line);
+	}
+};
+
+}
@@ -0,0 +1,141 @@
+#include <kernel/sync/wait_queue.hpp>
+#include <kernel/time/timer_wheel.hpp>
+#include <kernel/time/time.hpp>
+
+using namespace kernel::sync;
+
+void kernel::sync::block(Waiter* waiter) {
+	while (!__atomic_load_n(&waiter->woken, __ATOMIC_ACQUIRE)) {
+		if (waiter->thread) {
+			sched::block_current();
+			continue;
+		}
+		// sti only takes effect after the next instruction, so there is no window
+		// for the wake up interrupt to arrive before the hlt and leave us halted
+		trace_irqs_on();
+		asm volatile("sti; hlt; cli" : : : "memory");
+		trace_irqs_off();
+	}
+}
+
+void kernel::sync::wake(Waiter* waiter) {
+	// once woken, the waiter may go out of scope at any moment
+	auto* thread = waiter->thread;
+	__atomic_store_n(&waiter->woken, true, __ATOMIC_RELEASE);
+	if (thread) {
+		sched::wake(thread);
+	}
+}
+
+void WaitQueue::enqueue(Waiter* waiter) {
+	waiter->next = nullptr;
+	if (m_tail) {
+		m_tail->next = waiter;
+	} else {
+		m_head = waiter;
+	}
+	m_tail = waiter;
+}
+
+Waiter* WaitQueue::dequeue() {
+	auto* waiter = m_head;
+	if (!waiter) return nullptr;
+
+	m_head = waiter->next;
+	if (!m_head) {
+		m_tail = nullptr;
+	}
+	waiter->next = nullptr;
+	return waiter;
+}
+
+bool WaitQueue::remove(Waiter* waiter) {
+	Waiter* prev = nullptr;
+	for (auto* it = m_head; it; prev = it, it = it->next) {
+		if (it != waiter) continue;
+
+		if (prev) {
+			prev->next = it->next;
+		} else {
+			m_head = it->next;
+		}
+		if (m_tail == it) {
+			m_tail = prev;
+		}
+		it->next = nullptr;
+		return true;
+	}
+	return false;
+}
+
+void WaitQueue::wait() {
+	const auto flags = m_lock.lock_irqsave();
+	if (!(flags & RFLAGS_IF)) {
+		panic("Tried to block with interrupts disabled");
+	}
+	Waiter waiter;
+	// the waiter is out of the queue again before it goes out of scope, gcc just can't tell
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdangling-pointer"
+	enqueue(&waiter);
+#pragma GCC diagnostic pop
+	m_lock.unlock();
+	block(&waiter);
+	irq_restore(flags);
+}
+
+bool WaitQueue::wait_for(u64 timeout_ns) {
+	const auto flags = m_lock.lock_irqsave();
+	if (!(flags & RFLAGS_IF)) {
+		panic("Tried to block with interrupts disabled");
+	}
+
+	Waiter waiter;
+	// removed again below, whether it timed out or not
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdangling-pointer"
+	enqueue(&waiter);
+#pragma GCC diagnostic pop
+	m_lock.unlock();
+
+	// the timer only wakes the waiter, it's still in the queue afterwards
+	time::Timer timeout;
+	timeout.expires_ms = time::expires_ms_for(time::monotonic_ns() + timeout_ns);
+	timeout.context = &waiter;
+	timeout.callback = [](time::Timer* timer) {
+		wake(static_cast<Waiter*>(timer->context));
+	};
+	time::add_timer(&timeout);
+
+	block(&waiter);
+
+	// whoever woke us through the queue also took us out of it
+	m_lock.lock();
+	const bool timed_out = remove(&waiter);
+	m_lock.unlock();
+	// the callback may still be running on the CPU this blocked on
+	time::del_timer_sync(&timeout);
+	irq_restore(flags);
+	return !timed_out;
+}
+
+bool WaitQueue::wake_one() {
+	const auto flags = m_lock.lock_irqsave();
+	auto* waiter = dequeue();
+	if (waiter) {
+		wake(waiter);
+	}
+	m_lock.unlock_irqrestore(flags);
+	return waiter != nullptr;
+}
+
+usize WaitQueue::wake_all() {
+	const auto flags = m_lock.lock_irqsave();
+	usize count = 0;
+	while (auto* waiter = dequeue()) {
+		wake(waiter);
+		count++;
+	}
+	m_lock.unlock_irqrestore(flags);
+	return count;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stl/types.hpp>
+#include <kernel/intrinsics.hpp>
+#include <kernel/log.hpp>
+#include <kernel/sched/scheduler.hpp>
+#include <kernel/sync/spinlock.hpp>
+
+namespace kernel::sync {
+
+// Something blocked on an event. Lives on the stack of whoever is waiting.
+struct Waiter {
+	Waiter* next = nullptr;
+	// the thread to wake up, or null when waiting from outside of a thread
+	sched::Thread* thread = sched::can_block() ? sched::current() : nullptr;
+	bool woken = false;
+};
+
+// Blocks until `waiter` gets woken up. Must be called with interrupts disabled
+// (but enabled in the caller's context), and returns with them still disabled.
+// Threads get switched out, anything else halts the CPU until an interrupt wakes it.
+void block(Waiter* waiter);
+
+// Wakes up a waiter that is (or is about to be) blocked. Safe from interrupt handlers.
+void wake(Waiter* waiter);
+
+// A FIFO queue of waiters, woken up by some event such as an IRQ or a timer.
+// Waking is safe from interrupt handlers, and from any CPU.
+class WaitQueue {
+	Waiter* m_head = nullptr;
+	Waiter* m_tail = nullptr;
+	SpinLock m_lock;
+
+	// these must be called with the lock held
+	void enqueue(Waiter* waiter);
+	Waiter* dequeue();
+	// returns whether the waiter was still queued
+	bool remove(Waiter* waiter);
+
+public:
+	// Blocks until woken up by `wake_one` or `wake_all`.
+	void wait();
+
+	// Blocks until woken up, or until `timeout_ns` passes. Returns false on timeout.
+	// The timeout goes on the timer wheel, so it is only millisecond precise.
+	bool wait_for(u64 timeout_ns);
+
+	// Blocks until `condition` returns true, checking it again every time this is woken up.
+	// The condition is checked with the queue locked, so a wake up that happens right
+	// after checking it doesn't get lost.
+	template <class Func>
+	void wait_until(Func condition) {
+		const auto flags = m_lock.lock_irqsave();
+		if (!(flags & RFLAGS_IF)) {
+			panic("Tried to block with interrupts disabled");
+		}
+		while (!condition()) {
+			Waiter waiter;
+			enqueue(&waiter);
+			m_lock.unlock();
+			block(&waiter);
+			m_lock.lock();
+		}
+		m_lock.unlock_irqrestore(flags);
+	}
+
+	// Wakes up the oldest waiter. Returns whether there was one.
+	bool wake_one();
+
+	// Wakes up every waiter, returning how many there were.
+	usize wake_all();
+
+	bool is_empty() const { return m_head == nullptr; }
+};
+
+}
@@ -0,0 +1,165 @@
+#include <kernel/time/clock_event.hpp>
+#include <kernel/time/time.hpp>
+#include <kernel/cpu.hpp>
+#include <kernel/log.hpp>
+#include <kernel/intrinsics.hpp>
+
+using namespace kernel;
+using namespace kernel::time;
+
+static ClockEventDevice* current_device = nullptr;
+
+// must be called on the CPU that owns `timers`, with its lock held
+static void program_next_event(CPUTimers& timers) {
+	if (!current_device) return;
+
+	if (!timers.queue) {
+		if (timers.armed_deadline) {
+			current_device->stop();
+			timers.armed_deadline = 0;
+		}
+		return;
+	}
+
+	const auto deadline = timers.queue->deadline_ns;
+	if (timers.armed_deadline == deadline) return;
+
+	const auto now = monotonic_ns();
+	auto delta = deadline > now ? deadline - now : 0;
+	if (delta < current_device->min_delta_ns) delta = current_device->min_delta_ns;
+	if (delta > current_device->max_delta_ns) delta = current_device->max_delta_ns;
+
+	current_device->set_next_event(delta);
+	timers.armed_deadline = deadline;
+}
+
+// must be called with the lock of `timers` held
+static void dequeue(CPUTimers& timers, HighResTimer* timer) {
+	if (!timer->queued) return;
+
+	for (auto** it = &timers.queue; *it; it = &(*it)->next) {
+		if (*it == timer) {
+			*it = timer->next;
+			break;
+		}
+	}
+	timer->next = nullptr;
+	timer->queued = false;
+}
+
+// Locks the queue of the CPU the timer last went on, returning that CPU.
+// Returns null if the timer was never started.
+static CPU* lock_timer_cpu(HighResTimer* timer) {
+	while (true) {
+		auto* cpu = __atomic_load_n(&timer->cpu, __ATOMIC_ACQUIRE);
+		if (!cpu) return nullptr;
+		cpu->timers.lock.lock();
+		// it could have moved to another CPU while waiting for the lock
+		if (timer->cpu == cpu) return cpu;
+		cpu->timers.lock.unlock();
+	}
+}
+
+void kernel::time::register_clock_event(ClockEventDevice* device) {
+	// only ever called on the bootstrap CPU, before the others are started
+	auto& timers = this_cpu()->timers;
+	const auto flags = timers.lock.lock_irqsave();
+	if (!current_device || device->rating > current_device->rating) {
+		if (current_device && timers.armed_deadline) {
+			current_device->stop();
+		}
+		current_device = device;
+		timers.armed_deadline = 0;
+		program_next_event(timers);
+		kdbgln("Using {} as the clock event device", device->name);
+	}
+	timers.lock.unlock_irqrestore(flags);
+}
+
+bool kernel::time::has_clock_event() {
+	return current_device && (current_device->per_cpu || this_cpu()->id == 0);
+}
+
+void kernel::time::start_timer(HighResTimer* timer, u64 deadline_ns) {
+	const auto flags = irq_save();
+
+	// take it out of its old queue first, which may belong to another CPU.
+	// that CPU isn't re-armed, at worst it wakes up once for nothing
+	if (auto* old_cpu = lock_timer_cpu(timer)) {
+		dequeue(old_cpu->timers, timer);
+		old_cpu->timers.lock.unlock();
+	}
+
+	auto* cpu = this_cpu();
+	auto& timers = cpu->timers;
+	timers.lock.lock();
+
+	timer->deadline_ns = deadline_ns;
+	timer->queued = true;
+	__atomic_store_n(&timer->cpu, cpu, __ATOMIC_RELEASE);
+
+	auto** it = &timers.queue;
+	while (*it && (*it)->deadline_ns <= deadline_ns) {
+		it = &(*it)->next;
+	}
+	timer->next = *it;
+	*it = timer;
+
+	// only the head affects when the device has to fire
+	if (timers.queue == timer) {
+		program_next_event(timers);
+	}
+
+	timers.lock.unlock();
+	irq_restore(flags);
+}
+
+void kernel::time::cancel_timer(HighResTimer* timer) {
+	const auto flags = irq_save();
+	auto* cpu = lock_timer_cpu(timer);
+	if (!cpu) {
+		irq_restore(flags);
+		return;
+	}
+
+	auto& timers = cpu->timers;
+	const bool was_head = timers.queue == timer;
+	dequeue(timers, timer);
+	// another CPU's device can't be reprogrammed from here, so it just fires early
+	const bool is_local = cpu == this_cpu();
+	if (was_head && is_local) {
+		program_next_event(timers);
+	}
+	timers.lock.unlock();
+
+	// the callback may still be using whatever the timer is embedded in
+	if (!is_local) {
+		while (__atomic_load_n(&timers.running, __ATOMIC_ACQUIRE) == timer) {
+			cpu_relax();
+		}
+	}
+	irq_restore(flags);
+}
+
+void kernel::time::handle_clock_event() {
+	auto& timers = this_cpu()->timers;
+	timers.lock.lock();
+	timers.armed_deadline = 0;
+
+	// the callbacks may take a while, so keep checking the time
+	while (timers.queue && timers.queue->deadline_ns <= monotonic_ns()) {
+		auto* timer = timers.queue;
+		dequeue(timers, timer);
+		if (!timer->callback) continue;
+
+		__atomic_store_n(&timers.running, timer, __ATOMIC_RELAXED);
+		// callbacks are allowed to start and cancel timers, including on this queue
+		timers.lock.unlock();
+		timer->callback(timer);
+		timers.lock.lock();
+		__atomic_store_n(&timers.running, nullptr, __ATOMIC_RELEASE);
+	}
+
+	program_next_event(timers);
+	timers.lock.unlock();
+}
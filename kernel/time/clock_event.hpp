@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stl/types.hpp>
+#include <stl/string.hpp>
+#include <kernel/sync/spinlock.hpp>
+
+namespace kernel {
+struct CPU;
+}
+
+namespace kernel::time {
+
+// A device that can raise an interrupt after some time, such as the local APIC timer.
+// Devices are only ever armed for the next pending timer, so when nothing is
+// pending there are no interrupts at all.
+struct ClockEventDevice {
+	mat::StringView name;
+	// higher is better, the best registered device gets used
+	u32 rating = 0;
+	// range of deltas the device can be programmed with, in nanoseconds.
+	// longer deltas get clamped and the device is simply re-armed when it fires early
+	u64 min_delta_ns = 0;
+	u64 max_delta_ns = 0;
+	// arms the device to fire once, `delta_ns` nanoseconds from now
+	void (*set_next_event)(u64 delta_ns) = nullptr;
+	// disarms the device
+	void (*stop)() = nullptr;
+	// whether every CPU has its own instance, like the local APIC timer. otherwise
+	// the device only interrupts the bootstrap CPU, and timers only work there
+	bool per_cpu = false;
+};
+
+// A high resolution one-shot timer, kept in a queue sorted by deadline.
+// These are meant to be embedded in whatever owns them, nothing gets allocated.
+struct HighResTimer {
+	// absolute time, in the same base as `monotonic_ns`
+	u64 deadline_ns = 0;
+	// called from the clock event interrupt, with interrupts disabled
+	void (*callback)(HighResTimer* timer) = nullptr;
+	void* context = nullptr;
+
+	HighResTimer* next = nullptr;
+	// the CPU whose queue this is in, the one that started it last
+	CPU* cpu = nullptr;
+	bool queued = false;
+};
+
+// The timer queue of a CPU, part of the per-CPU data.
+struct CPUTimers {
+	// sorted by deadline, soonest first
+	HighResTimer* queue = nullptr;
+	// deadline the device is currently armed for, or 0 if it isn't
+	u64 armed_deadline = 0;
+	// the timer whose callback is running right now, so cancelling it can wait for that
+	HighResTimer* running = nullptr;
+	// other CPUs may cancel timers in here
+	sync::SpinLock lock;
+};
+
+// Registers a clock event device, switching to it if it is better than the current one.
+void register_clock_event(ClockEventDevice* device);
+
+// Whether timers can fire on the calling CPU. Until a device has been registered they never do.
+bool has_clock_event();
+
+// Called by the clock event device's interrupt handler, runs the expired timers
+// of this CPU and arms the device for the next one.
+void handle_clock_event();
+
+// Queues a timer to fire at `deadline_ns` on the calling CPU. If it was already queued, it gets moved.
+void start_timer(HighResTimer* timer, u64 deadline_ns);
+
+// Removes a timer from whichever queue it is in, does nothing if it wasn't queued.
+// If its callback is running on another CPU, waits for that to finish first.
+void cancel_timer(HighResTimer* timer);
+
+}
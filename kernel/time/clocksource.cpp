@@ -0,0 +1,11 @@
+#include <kernel/time/clocksource.hpp>
+#include <kernel/time/time.hpp>
+
+void kernel::time::ClockSource::set_frequency(u64 hz) {
+	frequency_hz = hz;
+	// with a fixed shift of 32, mult is the length of a cycle in 32.32 fixed point
+	// nanoseconds. split up the division so NS_PER_SEC << 32 doesn't overflow
+	shift = 32;
+	mult = (NS_PER_SEC / hz << 32) + ((NS_PER_SEC % hz << 32) / hz);
+	inverse_mult = (hz / NS_PER_SEC << 32) + ((hz % NS_PER_SEC << 32) / NS_PER_SEC);
+}
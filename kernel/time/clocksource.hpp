@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stl/types.hpp>
+#include <stl/string.hpp>
+#include <stl/math.hpp>
+
+namespace kernel::time {
+
+// A free running counter that time can be read from, such as the TSC.
+struct ClockSource {
+	mat::StringView name;
+	// higher is better, the best registered source is picked at boot
+	u32 rating = 0;
+	// reads the raw counter value
+	u64 (*read)() = nullptr;
+	// counters narrower than 64 bits wrap around, so deltas get masked by this.
+	// `monotonic_ns` counts the wraps of those, as long as it's read at least once per half wrap
+	u64 mask = ~u64(0);
+	u64 frequency_hz = 0;
+	// nanoseconds = (cycles * mult) >> shift, so reading needs no division
+	u64 mult = 0;
+	u32 shift = 0;
+	// same thing the other way around, cycles = (nanoseconds * inverse_mult) >> shift
+	u64 inverse_mult = 0;
+
+	// Sets the frequency, and computes the conversion factors from it.
+	void set_frequency(u64 hz);
+
+	u64 cycles_to_ns(u64 cycles) const {
+		return mat::math::mul_shift(cycles, mult, shift);
+	}
+
+	u64 ns_to_cycles(u64 ns) const {
+		return mat::math::mul_shift(ns, inverse_mult, shift);
+	}
+};
+
+// Makes a clock source available. The choice is only made once in `time::init`,
+// since switching sources afterwards could make time jump.
+void register_clock_source(ClockSource* source);
+
+}
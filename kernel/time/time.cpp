@@ -0,0 +1,125 @@
+#include <kernel/time/time.hpp>
+#include <kernel/time/clocksource.hpp>
+#include <kernel/time/tsc.hpp>
+#include <kernel/time/clock_event.hpp>
+#include <kernel/sync/wait_queue.hpp>
+#include <kernel/device/hpet.hpp>
+#include <kernel/log.hpp>
+
+using namespace kernel::time;
+
+static constexpr usize MAX_CLOCK_SOURCES = 4;
+
+// sleeps shorter than this just spin, arming a timer and waking up from hlt costs about as much
+static constexpr u64 MIN_BLOCKING_SLEEP_NS = 20 * NS_PER_US;
+
+static ClockSource* clock_sources[MAX_CLOCK_SOURCES];
+static usize clock_source_count = 0;
+
+static ClockSource* current_source = nullptr;
+static u64 base_cycles = 0;
+
+// Counters narrower than 64 bits (like a 32 bit HPET) wrap every few minutes, so for those
+// this is the latest value read, extended to 64 bits by adding up the deltas. That only
+// works if it gets read at least once every half wrap, which `wrap_guard` makes sure of.
+static u64 extended_cycles = 0;
+static HighResTimer wrap_guard;
+
+static u64 read_cycles() {
+	const auto mask = current_source->mask;
+	if (mask == ~u64(0)) {
+		return current_source->read();
+	}
+
+	const auto now = current_source->read();
+	auto last = __atomic_load_n(&extended_cycles, __ATOMIC_ACQUIRE);
+	while (true) {
+		const auto delta = (now - last) & mask;
+		// "negative", another CPU read the counter after this one did and got in first
+		if (delta > mask / 2) return last;
+		if (__atomic_compare_exchange_n(&extended_cycles, &last, last + delta, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			return last + delta;
+		}
+	}
+}
+
+// interval for `wrap_guard`, a quarter of a wrap leaves plenty of room for a late timer
+static u64 wrap_guard_interval_ns() {
+	return current_source->cycles_to_ns(current_source->mask / 4);
+}
+
+void kernel::time::register_clock_source(ClockSource* source) {
+	if (current_source) {
+		kdbgln("[time] clock source {} registered too late, ignoring", source->name);
+		return;
+	}
+	if (clock_source_count >= MAX_CLOCK_SOURCES) {
+		panic("Too many clock sources");
+	}
+	clock_sources[clock_source_count++] = source;
+}
+
+void kernel::time::init() {
+	hpet::init();
+	// the HPET is a much better reference than polling the PIT over port I/O
+	tsc::init(hpet::clock_source());
+
+	for (usize i = 0; i < clock_source_count; ++i) {
+		auto* source = clock_sources[i];
+		kdbgln("[time] clock source {} (rating {})", source->name, source->rating);
+		if (!current_source || source->rating > current_source->rating) {
+			current_source = source;
+		}
+	}
+
+	if (current_source->mask != ~u64(0)) {
+		extended_cycles = current_source->read() & current_source->mask;
+		// nothing to do but read the counter, which happens anyway when the timer fires.
+		// it only starts firing once a clock event device is registered, well within a wrap
+		wrap_guard.callback = [](HighResTimer* timer) {
+			start_timer(timer, monotonic_ns() + wrap_guard_interval_ns());
+		};
+	}
+	base_cycles = read_cycles();
+	if (wrap_guard.callback) {
+		start_timer(&wrap_guard, monotonic_ns() + wrap_guard_interval_ns());
+	}
+
+	kdbgln("Using {} as the clock source", current_source->name);
+}
+
+u64 kernel::time::monotonic_ns() {
+	return current_source->cycles_to_ns(read_cycles() - base_cycles);
+}
+
+u64 kernel::time::cycles_to_ns(u64 cycles) {
+	return tsc::clock_source()->cycles_to_ns(cycles);
+}
+
+void kernel::sleep_for(u64 duration_ns) {
+	const auto deadline = time::monotonic_ns() + duration_ns;
+
+	// blocking needs interrupts enabled to ever wake up
+	const auto flags = irq_save();
+	if (!(flags & RFLAGS_IF) || duration_ns < MIN_BLOCKING_SLEEP_NS || !time::has_clock_event()) {
+		irq_restore(flags);
+		while (time::monotonic_ns() < deadline) {
+			cpu_relax();
+		}
+		return;
+	}
+
+	sync::Waiter waiter;
+	time::HighResTimer timer;
+	timer.context = &waiter;
+	timer.callback = [](time::HighResTimer* timer) {
+		sync::wake(static_cast<sync::Waiter*>(timer->context));
+	};
+	time::start_timer(&timer, deadline);
+	sync::block(&waiter);
+	irq_restore(flags);
+}
+
+void kernel::sleep(u32 ms) {
+	sleep_for(ms * time::NS_PER_MS);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stl/types.hpp>
+#include <kernel/alternatives.hpp>
+#include <kernel/intrinsics.hpp>
+
+namespace kernel {
+
+namespace time {
+
+static constexpr u64 NS_PER_US = 1000;
+static constexpr u64 NS_PER_MS = 1000 * NS_PER_US;
+static constexpr u64 NS_PER_SEC = 1000 * NS_PER_MS;
+
+// Sets up the clock source. Has to be called before
+// anything else that needs the current time.
+void init();
+
+// Nanoseconds since `init` was called. Never goes backwards, and doesn't wrap even
+// when the clock source is narrower than 64 bits.
+u64 monotonic_ns();
+
+// Raw TSC value, for cheap cycle level measurements.
+// This is not serializing, so it may get reordered with nearby instructions.
+inline u64 cycles() {
+	return rdtsc();
+}
+
+// Like `cycles`, but waits for everything before it to finish first, for measuring
+// a stretch of code without it leaking out of the measured window.
+inline u64 ordered_cycles() {
+	u32 low, high;
+	// rdtscp waits by itself, but also writes the TSC_AUX MSR into ecx
+	asm volatile(ALTERNATIVE("lfence; rdtsc", "rdtscp")
+		: "=a"(low), "=d"(high)
+		: ALTERNATIVE_FEATURE(features::Feature::RDTSCP)
+		: "rcx");
+	return (u64(high) << 32) | low;
+}
+
+// Converts a TSC cycle delta, as returned by `cycles`, to nanoseconds.
+u64 cycles_to_ns(u64 cycles);
+
+}
+
+// Puts the CPU to sleep for at least `duration_ns`, waking up from a timer interrupt.
+// Very short sleeps, or ones from before timers work, spin instead.
+void sleep_for(u64 duration_ns);
+
+// Sleeps for a set number of milliseconds.
+void sleep(u32 ms);
+
+}
@@ -0,0 +1,317 @@
+#include <stl/math.hpp>
+#include <kernel/time/timer_wheel.hpp>
+#include <kernel/time/clock_event.hpp>
+#include <kernel/time/time.hpp>
+#include <kernel/cpu.hpp>
+#include <kernel/log.hpp>
+#include <kernel/intrinsics.hpp>
+
+using namespace kernel;
+using namespace kernel::time;
+
+static constexpr u32 ROOT_BITS = WHEEL_ROOT_BITS;
+static constexpr u32 LEVEL_BITS = WHEEL_LEVEL_BITS;
+static constexpr u32 ROOT_SIZE = 1 << ROOT_BITS;
+static constexpr u32 LEVEL_SIZE = 1 << LEVEL_BITS;
+static constexpr u32 UPPER_LEVELS = WHEEL_UPPER_LEVELS;
+static constexpr u64 MAX_DELTA = (u64(1) << (ROOT_BITS + UPPER_LEVELS * LEVEL_BITS)) - 1;
+
+u64 kernel::time::monotonic_ms() {
+	return monotonic_ns() / NS_PER_MS;
+}
+
+static bool is_root_bucket(TimerWheel& wheel, Timer** bucket) {
+	return bucket >= &wheel.root_buckets[0] && bucket < &wheel.root_buckets[ROOT_SIZE];
+}
+
+static void set_root_bit(TimerWheel& wheel, usize index, bool value) {
+	mat::math::set_bit(wheel.root_bitmap[index / 64], index % 64, value);
+}
+
+static void link(TimerWheel& wheel, Timer** bucket, Timer* timer) {
+	timer->next = *bucket;
+	if (timer->next) {
+		timer->next->pprev = &timer->next;
+	}
+	*bucket = timer;
+	timer->pprev = bucket;
+	timer->bucket = bucket;
+
+	if (is_root_bucket(wheel, bucket)) {
+		set_root_bit(wheel, bucket - wheel.root_buckets, true);
+	} else {
+		wheel.upper_pending++;
+	}
+}
+
+static void unlink(TimerWheel& wheel, Timer* timer) {
+	auto** bucket = timer->bucket;
+
+	*timer->pprev = timer->next;
+	if (timer->next) {
+		timer->next->pprev = timer->pprev;
+	}
+	timer->next = nullptr;
+	timer->pprev = nullptr;
+	timer->bucket = nullptr;
+
+	if (!is_root_bucket(wheel, bucket)) {
+		wheel.upper_pending--;
+	} else if (!*bucket) {
+		set_root_bit(wheel, bucket - wheel.root_buckets, false);
+	}
+}
+
+// must be called with the wheel's lock held
+static void insert(TimerWheel& wheel, Timer* timer) {
+	// already expired timers get run on the next tick
+	const auto now = wheel.current_ms;
+	const auto expires = timer->expires_ms < now ? now : timer->expires_ms;
+	const auto delta = expires - now;
+
+	if (delta < ROOT_SIZE) {
+		link(wheel, &wheel.root_buckets[expires % ROOT_SIZE], timer);
+		return;
+	}
+
+	for (u32 level = 0; level < UPPER_LEVELS; ++level) {
+		const auto shift = ROOT_BITS + level * LEVEL_BITS;
+		if (delta < u64(1) << (shift + LEVEL_BITS)) {
+			link(wheel, &wheel.upper_buckets[level][(expires >> shift) % LEVEL_SIZE], timer);
+			return;
+		}
+	}
+
+	// too far away to be represented, so park it in the furthest bucket.
+	// it gets reinserted from there when cascaded, closer to its actual expiry
+	const auto shift = ROOT_BITS + (UPPER_LEVELS - 1) * LEVEL_BITS;
+	link(wheel, &wheel.upper_buckets[UPPER_LEVELS - 1][((now + MAX_DELTA) >> shift) % LEVEL_SIZE], timer);
+}
+
+// Moves every timer in a bucket of an upper level down to where it belongs now.
+// Returns the index of the bucket, so the caller knows if the next level needs cascading too.
+static u64 cascade(TimerWheel& wheel, u32 level) {
+	const auto shift = ROOT_BITS + level * LEVEL_BITS;
+	const auto index = (wheel.current_ms >> shift) % LEVEL_SIZE;
+
+	auto* timer = wheel.upper_buckets[level][index];
+	while (timer) {
+		auto* next = timer->next;
+		unlink(wheel, timer);
+		insert(wheel, timer);
+		timer = next;
+	}
+	return index;
+}
+
+// Returns the next point in time where the wheel has work to do: either the
+// first non empty root bucket, or when the root level wraps and needs to cascade.
+// Returns 0 if there are no timers at all.
+static u64 next_event_ms(TimerWheel& wheel) {
+	const auto now = wheel.current_ms;
+	const auto start = now % ROOT_SIZE;
+	// right at the start of a rotation, so the upper levels need cascading first
+	if (start == 0 && wheel.upper_pending) {
+		return now;
+	}
+
+	// scan the rest of the current rotation
+	for (u64 index = start; index < ROOT_SIZE;) {
+		const auto word = wheel.root_bitmap[index / 64] >> (index % 64);
+		if (word) {
+			return now + (index + __builtin_ctzll(word) - start);
+		}
+		index = (index / 64 + 1) * 64;
+	}
+
+	if (wheel.upper_pending) {
+		return now + (ROOT_SIZE - start);
+	}
+
+	// timers from the start of the rotation would have expired already,
+	// unless they were added for the next rotation
+	for (u64 index = 0; index < start;) {
+		auto word = wheel.root_bitmap[index / 64];
+		if (index / 64 == start / 64) {
+			word &= mat::math::bit_mask<u64>(start % 64);
+		}
+		if (word) {
+			return now + (ROOT_SIZE - start) + index + __builtin_ctzll(word);
+		}
+		index += 64;
+	}
+
+	return 0;
+}
+
+// must be called on the CPU that owns the wheel, with its lock held
+static void arm(TimerWheel& wheel) {
+	const auto next = next_event_ms(wheel);
+	if (next == wheel.armed_ms) return;
+
+	wheel.armed_ms = next;
+	if (next) {
+		start_timer(&wheel.event, next * NS_PER_MS);
+	} else {
+		cancel_timer(&wheel.event);
+	}
+}
+
+static void run_timers(HighResTimer* event) {
+	auto& wheel = *static_cast<TimerWheel*>(event->context);
+	wheel.lock.lock();
+	wheel.armed_ms = 0;
+	wheel.running = true;
+	const auto now = monotonic_ms();
+
+	while (wheel.current_ms <= now) {
+		const auto current = wheel.current_ms;
+		const auto index = current % ROOT_SIZE;
+
+		if (index == 0) {
+			for (u32 level = 0; level < UPPER_LEVELS && cascade(wheel, level) == 0; ++level);
+		}
+
+		// move on before running anything, so that timers added by the callbacks
+		// for an already expired time end up in the next bucket and not this one
+		wheel.current_ms++;
+
+		// the callbacks may change the bucket, so start over after every one.
+		// timers added back into this bucket are for the next rotation, so skip those
+		bool ran_any = true;
+		while (ran_any) {
+			ran_any = false;
+			for (auto* timer = wheel.root_buckets[index]; timer; timer = timer->next) {
+				if (timer->expires_ms <= current) {
+					unlink(wheel, timer);
+					__atomic_store_n(&wheel.running_timer, timer, __ATOMIC_RELAXED);
+					// the callbacks may add timers back in
+					wheel.lock.unlock();
+					timer->callback(timer);
+					wheel.lock.lock();
+					__atomic_store_n(&wheel.running_timer, nullptr, __ATOMIC_RELEASE);
+					ran_any = true;
+					break;
+				}
+			}
+		}
+
+		// skip ahead to the next bucket that has anything to do, instead of going one by one
+		const auto next = next_event_ms(wheel);
+		wheel.current_ms = next && next <= now ? next : now + 1;
+	}
+
+	wheel.running = false;
+	arm(wheel);
+	wheel.lock.unlock();
+}
+
+// must be called on the CPU that owns the wheel, with its lock held
+static void add_locked(TimerWheel& wheel, Timer* timer) {
+	if (!wheel.event.callback) {
+		wheel.event.callback = &run_timers;
+		wheel.event.context = &wheel;
+	}
+	// the wheel doesn't move forward while its empty, so catch it up first
+	if (!wheel.running && !next_event_ms(wheel)) {
+		wheel.current_ms = monotonic_ms();
+	}
+	timer->wheel = &wheel;
+	insert(wheel, timer);
+	// run_timers arms once its done
+	if (!wheel.running) {
+		arm(wheel);
+	}
+}
+
+// Locks the wheel the timer was last added to, returning it.
+// Returns null if the timer was never added.
+static TimerWheel* lock_timer_wheel(Timer* timer) {
+	while (true) {
+		auto* wheel = __atomic_load_n(&timer->wheel, __ATOMIC_ACQUIRE);
+		if (!wheel) return nullptr;
+		wheel->lock.lock();
+		// it could have moved to another CPU while waiting for the lock
+		if (timer->wheel == wheel) return wheel;
+		wheel->lock.unlock();
+	}
+}
+
+void kernel::time::add_timer(Timer* timer) {
+	if (timer->is_pending()) {
+		panic("Tried to add a timer that is already pending");
+	}
+
+	const auto flags = irq_save();
+	auto& wheel = this_cpu()->timer_wheel;
+	wheel.lock.lock();
+	add_locked(wheel, timer);
+	wheel.lock.unlock();
+	irq_restore(flags);
+}
+
+bool kernel::time::mod_timer(Timer* timer, u64 expires_ms) {
+	const auto flags = irq_save();
+
+	// take it out of its old wheel first, which may belong to another CPU.
+	// that CPU isn't re-armed, at worst it wakes up once for nothing
+	bool was_pending = false;
+	if (auto* old_wheel = lock_timer_wheel(timer)) {
+		was_pending = timer->is_pending();
+		if (was_pending) {
+			unlink(*old_wheel, timer);
+		}
+		old_wheel->lock.unlock();
+	}
+
+	auto& wheel = this_cpu()->timer_wheel;
+	wheel.lock.lock();
+	timer->expires_ms = expires_ms;
+	add_locked(wheel, timer);
+	wheel.lock.unlock();
+	irq_restore(flags);
+	return was_pending;
+}
+
+bool kernel::time::del_timer(Timer* timer) {
+	const auto flags = irq_save();
+	auto* wheel = lock_timer_wheel(timer);
+	if (!wheel) {
+		irq_restore(flags);
+		return false;
+	}
+
+	const bool was_pending = timer->is_pending();
+	if (was_pending) {
+		// not re-arming here, at worst the wheel wakes up once for nothing
+		unlink(*wheel, timer);
+	}
+	wheel->lock.unlock();
+	irq_restore(flags);
+	return was_pending;
+}
+
+bool kernel::time::del_timer_sync(Timer* timer) {
+	const auto flags = irq_save();
+	auto* wheel = lock_timer_wheel(timer);
+	if (!wheel) {
+		irq_restore(flags);
+		return false;
+	}
+
+	const bool was_pending = timer->is_pending();
+	if (was_pending) {
+		unlink(*wheel, timer);
+	}
+	wheel->lock.unlock();
+
+	// callbacks run with interrupts disabled, so if it's running on this CPU
+	// then this is being called from the callback itself
+	if (wheel != &this_cpu()->timer_wheel) {
+		while (__atomic_load_n(&wheel->running_timer, __ATOMIC_ACQUIRE) == timer) {
+			cpu_relax();
+		}
+	}
+	irq_restore(flags);
+	return was_pending;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stl/types.hpp>
+#include <stl/math.hpp>
+#include <kernel/time/clock_event.hpp>
+#include <kernel/time/time.hpp>
+#include <kernel/sync/spinlock.hpp>
+
+namespace kernel::time {
+
+struct TimerWheel;
+
+// A coarse (millisecond resolution) timer, for timeouts and other things that
+// don't need to be precise. Kept in a hierarchical timing wheel, so adding and
+// removing is O(1) no matter how many are pending.
+// Like HighResTimer, these are embedded in whatever owns them, nothing gets allocated.
+struct Timer {
+	// absolute time in milliseconds, in the same base as `monotonic_ms`
+	u64 expires_ms = 0;
+	// called from the clock event interrupt, with interrupts disabled
+	void (*callback)(Timer* timer) = nullptr;
+	void* context = nullptr;
+
+	// links for the wheel bucket this is in, all null when not pending
+	Timer* next = nullptr;
+	Timer** pprev = nullptr;
+	Timer** bucket = nullptr;
+	// the wheel this is in, the one of the CPU that added it last
+	TimerWheel* wheel = nullptr;
+
+	bool is_pending() const { return bucket != nullptr; }
+};
+
+// The root level has a bucket for every millisecond in the next 256ms.
+// Each level above has 64 buckets, each spanning a whole rotation of the level below.
+// Timers in the upper levels get cascaded down whenever the level below wraps around,
+// until they end up in the root level. Overall this covers 2^32 ms, or ~49 days.
+static constexpr u32 WHEEL_ROOT_BITS = 8;
+static constexpr u32 WHEEL_LEVEL_BITS = 6;
+static constexpr u32 WHEEL_UPPER_LEVELS = 4;
+
+// The timers of a CPU, part of the per-CPU data. Timers fire on the CPU that added them.
+struct TimerWheel {
+	Timer* root_buckets[1 << WHEEL_ROOT_BITS] = {};
+	// one bit per root bucket, set if it has any timers
+	u64 root_bitmap[(1 << WHEEL_ROOT_BITS) / 64] = {};
+
+	Timer* upper_buckets[WHEEL_UPPER_LEVELS][1 << WHEEL_LEVEL_BITS] = {};
+	usize upper_pending = 0;
+
+	// every timer with expires_ms < current_ms has already been run
+	u64 current_ms = 0;
+
+	// used to wake up when the wheel has work to do
+	HighResTimer event;
+	// 0 when not armed
+	u64 armed_ms = 0;
+	bool running = false;
+	// the timer whose callback is running right now, so `del_timer_sync` can wait for that
+	Timer* running_timer = nullptr;
+
+	// other CPUs may delete timers in here
+	sync::SpinLock lock;
+};
+
+// Milliseconds since boot, the time base used by timers.
+u64 monotonic_ms();
+
+// The expiry for a timer that should fire once `monotonic_ns` reaches `deadline_ns`.
+// Rounded up, so it never fires early.
+inline u64 expires_ms_for(u64 deadline_ns) {
+	return mat::math::div_ceil(deadline_ns, NS_PER_MS);
+}
+
+// Starts a timer that fires at `timer->expires_ms`, on the calling CPU. The timer must not be pending.
+void add_timer(Timer* timer);
+
+// Changes when a timer fires, moving it to the calling CPU's wheel. Returns whether it was pending.
+// The wheel it came from isn't re-armed, so that CPU may wake up once for nothing.
+bool mod_timer(Timer* timer, u64 expires_ms);
+
+// Stops a timer. Returns whether it was pending.
+// Its callback may still be running on another CPU afterwards. The wheel isn't re-armed,
+// so it may wake up once for nothing, which is cheaper than reprogramming the device every time.
+bool del_timer(Timer* timer);
+
+// Like `del_timer`, but if the callback is running on another CPU, waits for it to finish,
+// so whatever the timer is embedded in can go away afterwards. From the timer's own
+// callback it doesn't wait.
+bool del_timer_sync(Timer* timer);
+
+}
@@ -0,0 +1,94 @@
+#include <kernel/time/tsc.hpp>
+#include <kernel/time/time.hpp>
+#include <kernel/device/pit.hpp>
+#include <kernel/log.hpp>
+#include <kernel/features.hpp>
+#include <kernel/intrinsics.hpp>
+
+// how long to measure the TSC for, each try
+static constexpr u32 CALIBRATION_MS = 10;
+static constexpr u32 CALIBRATION_TRIES = 3;
+
+static bool invariant = false;
+
+static u64 read_tsc() {
+	return rdtsc();
+}
+
+static kernel::time::ClockSource tsc_source = {
+	.name = "tsc",
+	.read = &read_tsc,
+};
+
+using namespace kernel;
+
+// Measures the TSC frequency in hz over CALIBRATION_MS, according to the PIT
+static u64 measure_against_pit() {
+	static constexpr u16 pit_ticks = pit::PIT_CLOCK_HZ / 1000 * CALIBRATION_MS;
+
+	const auto flags = irq_save();
+	const auto start = time::ordered_cycles();
+	pit::poll_wait(pit_ticks);
+	const auto end = time::ordered_cycles();
+	irq_restore(flags);
+
+	return (end - start) * (1000 / CALIBRATION_MS);
+}
+
+// Measures the TSC frequency in hz over CALIBRATION_MS, according to another clock source
+static u64 measure_against(const time::ClockSource* reference) {
+	const auto target = reference->ns_to_cycles(CALIBRATION_MS * time::NS_PER_MS);
+
+	const auto flags = irq_save();
+	const auto ref_start = reference->read();
+	const auto start = time::ordered_cycles();
+	u64 ref_end;
+	while ((((ref_end = reference->read()) - ref_start) & reference->mask) < target) {
+		cpu_relax();
+	}
+	const auto end = time::ordered_cycles();
+	irq_restore(flags);
+
+	// the reference may have ticked a bit past the target, so use the actual delta
+	const auto ref_delta = (ref_end - ref_start) & reference->mask;
+	return (end - start) * reference->frequency_hz / ref_delta;
+}
+
+void kernel::tsc::init(const time::ClockSource* reference) {
+	invariant = features::has(features::Feature::InvariantTSC);
+	if (!invariant) {
+		kdbgln("[TSC] not invariant, time may drift with frequency scaling");
+	}
+
+	// anything that interrupts a PIT measurement (SMIs, the host preempting us)
+	// can only make it longer, so the shortest one is the most accurate.
+	// a memory mapped reference is read right next to the TSC, so there it matters less
+	u64 hz = ~u64(0);
+	for (u32 i = 0; i < CALIBRATION_TRIES; ++i) {
+		const auto value = reference ? measure_against(reference) : measure_against_pit();
+		if (value < hz) hz = value;
+	}
+
+	tsc_source.set_frequency(hz);
+	// a TSC that changes speed is worse than anything else we have
+	tsc_source.rating = invariant ? 300 : 100;
+	time::register_clock_source(&tsc_source);
+
+	kdbgln("TSC calibrated at {} kHz against the {}", hz / 1000, reference ? reference->name : "pit");
+}
+
+bool kernel::tsc::is_invariant() {
+	return invariant;
+}
+
+u64 kernel::tsc::frequency_hz() {
+	return tsc_source.frequency_hz;
+}
+
+u64 kernel::tsc::ns_to_cycles(u64 ns) {
+	return tsc_source.ns_to_cycles(ns);
+}
+
+time::ClockSource* kernel::tsc::clock_source() {
+	return &tsc_source;
+}
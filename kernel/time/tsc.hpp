@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stl/types.hpp>
+#include <kernel/time/clocksource.hpp>
+
+namespace kernel::tsc {
+
+// Detects whether the TSC is invariant, calibrates it and registers it as a clock source.
+// Calibrates against `reference` if given, otherwise falls back to the PIT.
+void init(const time::ClockSource* reference);
+
+// Whether the TSC ticks at a constant rate regardless of P/C-states,
+// which is required for it to be a reliable clock source.
+bool is_invariant();
+
+u64 frequency_hz();
+
+// Converts a duration in nanoseconds to TSC cycles.
+u64 ns_to_cycles(u64 ns);
+
+time::ClockSource* clock_source();
+
+}
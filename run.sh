@@ -4,6 +4,8 @@ NAME=kernel.iso
 BUILT_PATH=build/$NAME
 
 QEMU=qemu-system-x86_64
+# how many CPUs to give it, e.g. CPUS=4 ./run.sh
+CPUS=${CPUS:-1}
 
 if [ "$1" == "debug" ]; then
 	EXTRA_ARGS="-s -S"
@@ -14,4 +16,4 @@ if [ "$1" == "wsl" ]; then
 	EXTRA_ARGS="-display sdl"
 fi
 
-$QEMU -M q35 -m 1G -cdrom $BUILT_PATH -boot d -serial stdio $EXTRA_ARGS
+$QEMU -M q35 -m 1G -smp $CPUS -cdrom $BUILT_PATH -boot d -serial stdio $EXTRA_ARGS
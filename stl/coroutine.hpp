@@ -0,0 +1,121 @@
+#pragma once
+
+#include "stl.hpp"
+#include "types.hpp"
+
+// The compiler looks for these in std when it sees a coroutine, and <coroutine>
+// drags in the rest of libstdc++, so this is a freestanding copy of the bits it needs.
+// Everything is built on the gcc builtins, same as the real header.
+namespace std {
+
+template <class Return, class... Args>
+struct coroutine_traits {};
+
+template <class Return, class... Args>
+requires requires { typename Return::promise_type; }
+struct coroutine_traits<Return, Args...> {
+	using promise_type = typename Return::promise_type;
+};
+
+template <class Promise = void>
+struct coroutine_handle;
+
+template <>
+struct coroutine_handle<void> {
+protected:
+	void* m_frame = nullptr;
+
+public:
+	constexpr coroutine_handle() = default;
+	constexpr coroutine_handle(decltype(nullptr)) {}
+
+	static constexpr coroutine_handle from_address(void* frame) {
+		coroutine_handle handle;
+		handle.m_frame = frame;
+		return handle;
+	}
+	constexpr void* address() const { return m_frame; }
+
+	constexpr explicit operator bool() const { return m_frame != nullptr; }
+
+	bool done() const { return __builtin_coro_done(m_frame); }
+	void resume() const { __builtin_coro_resume(m_frame); }
+	void operator()() const { resume(); }
+	void destroy() const { __builtin_coro_destroy(m_frame); }
+
+	friend constexpr bool operator==(coroutine_handle a, coroutine_handle b) {
+		return a.m_frame == b.m_frame;
+	}
+};
+
+template <class Promise>
+struct coroutine_handle : coroutine_handle<void> {
+	constexpr coroutine_handle() = default;
+	constexpr coroutine_handle(decltype(nullptr)) {}
+
+	static coroutine_handle from_promise(Promise& promise) {
+		coroutine_handle handle;
+		handle.m_frame = __builtin_coro_promise(&promise, alignof(Promise), true);
+		return handle;
+	}
+	static constexpr coroutine_handle from_address(void* frame) {
+		coroutine_handle handle;
+		handle.m_frame = frame;
+		return handle;
+	}
+
+	Promise& promise() const {
+		return *static_cast<Promise*>(__builtin_coro_promise(m_frame, alignof(Promise), false));
+	}
+};
+
+struct noop_coroutine_promise {};
+
+// A coroutine that does nothing when resumed, for symmetric transfer to return
+// when there is nothing else to run. Its frame is laid out like the ones gcc
+// generates, a resume and a destroy pointer followed by the promise.
+template <>
+struct coroutine_handle<noop_coroutine_promise> : coroutine_handle<void> {
+private:
+	struct Frame {
+		static void nothing() {}
+		void (*resume)() = &nothing;
+		void (*destroy)() = &nothing;
+		noop_coroutine_promise promise;
+	};
+	static Frame s_frame;
+
+	friend coroutine_handle noop_coroutine();
+	coroutine_handle() { m_frame = &s_frame; }
+
+public:
+	constexpr bool done() const { return false; }
+	void resume() const {}
+	void operator()() const {}
+	void destroy() const {}
+
+	noop_coroutine_promise& promise() const { return s_frame.promise; }
+};
+
+using noop_coroutine_handle = coroutine_handle<noop_coroutine_promise>;
+
+// constant initialized, the kernel never runs global constructors
+constinit inline noop_coroutine_handle::Frame noop_coroutine_handle::s_frame {};
+
+inline noop_coroutine_handle noop_coroutine() {
+	return noop_coroutine_handle();
+}
+
+struct suspend_always {
+	constexpr bool await_ready() const noexcept { return false; }
+	constexpr void await_suspend(coroutine_handle<>) const noexcept {}
+	constexpr void await_resume() const noexcept {}
+};
+
+struct suspend_never {
+	constexpr bool await_ready() const noexcept { return true; }
+	constexpr void await_suspend(coroutine_handle<>) const noexcept {}
+	constexpr void await_resume() const noexcept {}
+};
+
+}
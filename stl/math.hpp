@@ -21,7 +21,7 @@ constexpr Int bit_mask(Int n) {
 template <concepts::integral Int>
 constexpr void set_bit(Int& target, u64 idx, bool value) {
 	const Int mask = Int(1) << idx;
-	target = (target & ~mask) | (value << idx);
+	target = (target & ~mask) | (Int(value) << idx);
 }
 
 // Gets a specific bit at "idx".
@@ -31,4 +31,11 @@ constexpr bool get_bit(Int value, u64 idx) {
 	return value & mask;
 }
 
+// Computes (value * mult) >> shift without overflowing the multiplication.
+// Meant for fixed point conversions, such as clock cycles to nanoseconds.
+constexpr u64 mul_shift(u64 value, u64 mult, u32 shift) {
+	// compiles down to a single 64x64 -> 128 bit mul on x86_64
+	return static_cast<u64>((static_cast<unsigned __int128>(value) * mult) >> shift);
+}
+
 }
\ No newline at end of file
@@ -8,4 +8,8 @@ namespace STL_NS {
 // Fills the memory from ptr to ptr+bytes with value.
 void memset(void* ptr, u8 value, usize bytes);
 
-}
\ No newline at end of file
+}
+
+// placement new, since there is no <new> to get it from
+inline void* operator new(usize, void* ptr) noexcept { return ptr; }
+inline void operator delete(void*, void*) noexcept {}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "stl.hpp"
+#include "types.hpp"
+
+namespace STL_NS {
+
+// A fixed size ring buffer for exactly one producer and one consumer, which may be on
+// different CPUs or one of them in an interrupt handler, without any locking.
+// Capacity has to be a power of two, so the indices can just keep going up and wrap around.
+template <class Type, usize Capacity>
+requires (Capacity != 0 && (Capacity & (Capacity - 1)) == 0)
+class SPSCRing {
+	// each side only writes its own index, and they're kept on separate cache lines
+	// so the producer and consumer don't keep taking the line from each other
+	alignas(64) usize m_head = 0;
+	alignas(64) usize m_tail = 0;
+	Type m_data[Capacity];
+
+public:
+	// Adds an element, or returns false if the ring is full. Producer only.
+	bool push(const Type& value) {
+		const auto head = m_head;
+		if (head - __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE) == Capacity) return false;
+		m_data[head % Capacity] = value;
+		// publishes the element along with the index
+		__atomic_store_n(&m_head, head + 1, __ATOMIC_RELEASE);
+		return true;
+	}
+
+	// Takes the oldest element, or returns false if there is none. Consumer only.
+	bool pop(Type& value) {
+		return pop_batch(&value, 1);
+	}
+
+	// Takes up to `max` elements at once, returning how many. Consumer only.
+	usize pop_batch(Type* values, usize max) {
+		const auto tail = m_tail;
+		const auto available = __atomic_load_n(&m_head, __ATOMIC_ACQUIRE) - tail;
+		const auto count = available < max ? available : max;
+		for (usize i = 0; i < count; ++i) {
+			values[i] = m_data[(tail + i) % Capacity];
+		}
+		// the slots may only be reused once they've been read
+		__atomic_store_n(&m_tail, tail + count, __ATOMIC_RELEASE);
+		return count;
+	}
+
+	// Only a snapshot, either side may change it right after.
+	usize size() const {
+		return __atomic_load_n(&m_head, __ATOMIC_ACQUIRE) - __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE);
+	}
+
+	bool is_empty() const { return size() == 0; }
+
+	static constexpr usize capacity() { return Capacity; }
+};
+
+}
@@ -10,18 +10,19 @@ class StringView {
 	char const* m_data = nullptr;
 	usize m_size = 0;
 public:
-	StringView(const char* c_str) : m_data(c_str) {
+	// constexpr so that globals holding one don't need a constructor to run, which the kernel never does
+	constexpr StringView(const char* c_str) : m_data(c_str) {
 		while (*c_str != 0) {
 			++m_size;
 			++c_str;
 		}
 	}
-	StringView(const char* begin, const char* end) : m_data(begin) {
+	constexpr StringView(const char* begin, const char* end) : m_data(begin) {
 		m_size = end - begin;
 	}
 
-	const char* data() const { return m_data; }
-	auto size() const { return m_size; }
+	constexpr const char* data() const { return m_data; }
+	constexpr auto size() const { return m_size; }
 
 	const char* begin() const { return data(); }
 	const char* end() const { return data() + size(); }